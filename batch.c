@@ -0,0 +1,147 @@
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/wait.h>
+
+/**********************************************************/
+int randomOpening( Position * pos, int plies, uint64_t * state )
+{
+	Move moves[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE ];
+	Move move;
+	int i, j, k, total_moves;
+
+	initPosition( pos );
+
+	for( k = 0; k < plies; k++ )
+	{
+		total_moves = 0;
+		for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+			for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+				if( isLegal( pos, i, j, pos->turn ) )
+				{
+					moves[ total_moves ].tile[ 0 ] = i;
+					moves[ total_moves ].tile[ 1 ] = j;
+					moves[ total_moves ].color = pos->turn;
+					total_moves++;
+				}
+
+		if( total_moves == 0 )
+		{
+			// game over
+			if( !canMove( pos, getOtherSide( pos->turn ) ) )
+				return FALSE;
+
+			move.tile[ 0 ] = NULL_MOVE;
+			move.color = pos->turn;
+			doMove( pos, &move );
+			continue;
+		}
+
+		doMove( pos, &moves[ nextRandom( state ) % total_moves ] );
+	}
+
+	return TRUE;
+}
+
+int gameOpening( Position * pos, int plies, uint64_t seed, int game )
+{
+	uint64_t state = seed * 0x100000001B3ULL + game;
+
+	return randomOpening( pos, plies, &state );
+}
+
+/**********************************************************/
+int onlineWorkers( int threadsPerWorker )
+{
+	long cores = sysconf( _SC_NPROCESSORS_ONLN );
+	int workers = cores / threadsPerWorker;
+
+	if( workers < 1 )
+		return 1;
+	return workers > MAX_WORKERS ? MAX_WORKERS : workers;
+}
+
+int runWorkers( int workers, WorkerJob job, int recordSize, RecordHandler handler )
+{
+	struct pollfd pipes[ MAX_WORKERS ];
+	int filled[ MAX_WORKERS ];				// bytes of the next record read so far
+	char * partial;
+	int w, open_pipes, received = 0;
+
+	if( ( partial = malloc( workers * recordSize ) ) == NULL )
+	{
+		printf( "ERROR: Out of memory\n" );
+		return -1;
+	}
+
+	for( w = 0; w < workers; w++ )
+	{
+		int fd[ 2 ];
+
+		if( pipe( fd ) < 0 )
+		{
+			printf( "ERROR: Could not create a pipe\n" );
+			return -1;
+		}
+
+		// a worker must not write out what the parent still has buffered
+		fflush( NULL );
+		switch( fork() )
+		{
+			case -1:
+				printf( "ERROR: Could not start worker %d\n", w );
+				return -1;
+			case 0:
+				for( int k = 0; k < w; k++ )
+					close( pipes[ k ].fd );
+				close( fd[ 0 ] );
+				job( w, workers, fd[ 1 ] );
+				close( fd[ 1 ] );
+				exit( 0 );
+		}
+
+		close( fd[ 1 ] );
+		pipes[ w ].fd = fd[ 0 ];
+		pipes[ w ].events = POLLIN;
+		filled[ w ] = 0;
+	}
+
+	for( open_pipes = workers; open_pipes > 0; )
+	{
+		if( poll( pipes, workers, -1 ) < 0 )
+			continue;
+
+		for( w = 0; w < workers; w++ )
+		{
+			char * record = partial + w * recordSize;
+			ssize_t length;
+
+			if( pipes[ w ].fd < 0 || !( pipes[ w ].revents & ( POLLIN | POLLHUP ) ) )
+				continue;
+
+			length = read( pipes[ w ].fd, record + filled[ w ], recordSize - filled[ w ] );
+			if( length <= 0 )
+			{
+				close( pipes[ w ].fd );
+				pipes[ w ].fd = -1;
+				open_pipes--;
+				continue;
+			}
+
+			if( ( filled[ w ] += length ) < recordSize )
+				continue;
+
+			filled[ w ] = 0;
+			received++;
+			handler( record );
+		}
+	}
+
+	while( wait( NULL ) > 0 )
+		;
+
+	free( partial );
+	return received;
+}
@@ -0,0 +1,33 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include <stdint.h>
+
+/**********************************************************/
+// upper limit for the number of worker processes
+#define MAX_WORKERS 256
+
+/* The pool runs job( worker, workers, output ) in each worker process, which writes fixed size records to output.
+   The parent hands each record to the handler as it arrives (records of one worker stay in order) */
+typedef void ( * WorkerJob )( int worker, int workers, int output );
+typedef void ( * RecordHandler )( void * record );
+
+/**********************************************************/
+int randomOpening( Position * pos, int plies, uint64_t * state );
+//plays plies random legal moves from initPosition() (null moves on passes), drawn from nextRandom( state ).
+//Returns FALSE if the game ended during the opening
+
+int gameOpening( Position * pos, int plies, uint64_t seed, int game );
+//randomOpening() of game number game of a run seeded with seed, the same in every worker process
+
+int onlineWorkers( int threadsPerWorker );
+//one worker per threadsPerWorker online cores, between 1 and MAX_WORKERS
+
+int runWorkers( int workers, WorkerJob job, int recordSize, RecordHandler handler );
+//forks workers processes (the search keeps its state in globals, so one process each) and waits until they are done.
+//Returns the number of records received, or -1 if a worker could not be started
+
+#endif
@@ -0,0 +1,235 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "comm.h"
+#include "transposition.h"
+#include "pattern.h"
+#include "search.h"
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+
+
+/**********************************************************/
+// fixed search depth of every benchmark position (-d)
+#define DEFAULT_BENCH_DEPTH 7
+
+// positions made by -g are taken this many random plies into a game
+#define MIN_RANDOM_PLIES 8
+#define MAX_RANDOM_PLIES 120
+
+// seed of the position generator, keep it fixed so that bench.pos can be rebuilt
+#define BENCH_SEED 0x4845584245544348ULL
+/**********************************************************/
+
+char * positionsFile = "bench.pos";	// positions to search, stored one after the other in wire format
+
+char * weightsFile = NULL;	// evaluation weights (built-in defaults if not given)
+
+int hashMegabytes = DEFAULT_TT_MEGABYTES;	// size of the transposition table
+
+uint64_t randomState = BENCH_SEED;
+/**********************************************************/
+
+
+// --- Count the legal moves of the side to move ---
+int countLegalMoves( Position * pos )
+{
+	int i, j, total_moves = 0;
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			if( isLegal( pos, i, j, pos->turn ) )
+				total_moves++;
+
+	return total_moves;
+}
+
+// --- Write (count) random middle game positions to the positions file ---
+int generatePositions( int count )
+{
+	char buffer[ POSITION_BUFFER_SIZE ];
+	Position pos;
+	FILE * file;
+	int written = 0;
+
+	if( ( file = fopen( positionsFile, "wb" ) ) == NULL )
+	{
+		printf( "Could not create %s\n", positionsFile );
+		return -1;
+	}
+
+	while( written < count )
+	{
+		int plies = MIN_RANDOM_PLIES + nextRandom( &randomState ) % ( MAX_RANDOM_PLIES - MIN_RANDOM_PLIES + 1 );
+
+		// a position with a single move is never searched
+		if( !randomOpening( &pos, plies, &randomState ) || countLegalMoves( &pos ) < 2 )
+			continue;
+
+		packPosition( &pos, buffer );
+		if( fwrite( buffer, POSITION_BUFFER_SIZE, 1, file ) != 1 )
+		{
+			printf( "Could not write %s\n", positionsFile );
+			fclose( file );
+			return -1;
+		}
+		written++;
+	}
+
+	fclose( file );
+	printf( "%d positions written to %s\n", written, positionsFile );
+	return 0;
+}
+
+// --- Search every position of the positions file to a fixed depth and report speed ---
+int runBenchmark( void )
+{
+	char buffer[ POSITION_BUFFER_SIZE ];
+	Position pos;
+	Move bestMove;
+	FILE * file;
+	int index = 0;
+
+	long long totalNodes = 0;
+	long totalTime = 0;
+	long depthTime[ MAX_SEARCH_DEPTH + 1 ] = { 0 };
+	int depthCount[ MAX_SEARCH_DEPTH + 1 ] = { 0 };
+	uint64_t checksum = 0xCBF29CE484222325ULL;
+
+	if( ( file = fopen( positionsFile, "rb" ) ) == NULL )
+	{
+		printf( "Could not open %s\n", positionsFile );
+		return -1;
+	}
+
+	printf( "  #  depth        nodes    ms         nps  move\n" );
+
+	while( fread( buffer, POSITION_BUFFER_SIZE, 1, file ) == 1 )
+	{
+		unpackPosition( buffer, &pos );
+
+		// every position starts from an empty table, so results don't depend on the order
+		clearTranspositionTable();
+		bestMove = getBestMove( &pos, pos.turn );
+
+		printf( "%3d  %5d  %11lld  %4ld  %10lld  %d %d\n", ++index, searchInfo.depth, searchInfo.nodes, searchInfo.time,
+				searchInfo.nodes * 1000 / ( searchInfo.time > 0 ? searchInfo.time : 1 ), bestMove.tile[ 0 ], bestMove.tile[ 1 ] );
+
+		totalNodes += searchInfo.nodes;
+		totalTime += searchInfo.time;
+		for( int d = 1; d <= searchInfo.depth && d <= MAX_SEARCH_DEPTH; d++ )
+		{
+			depthTime[ d ] += searchInfo.depthTime[ d ];
+			depthCount[ d ]++;
+		}
+
+		// FNV-1a over node counts and moves, a changed search shows up as a changed checksum
+		uint64_t values[ 3 ] = { (uint64_t) searchInfo.nodes, (uint64_t) bestMove.tile[ 0 ], (uint64_t) bestMove.tile[ 1 ] };
+		for( int v = 0; v < 3; v++ )
+		{
+			checksum ^= values[ v ];
+			checksum *= 0x100000001B3ULL;
+		}
+	}
+
+	fclose( file );
+
+	if( index == 0 )
+	{
+		printf( "No positions in %s\n", positionsFile );
+		return -1;
+	}
+
+	printf( "\nTime to depth (average ms over the positions reaching it)\n" );
+	for( int d = 1; d <= MAX_SEARCH_DEPTH; d++ )
+		if( depthCount[ d ] > 0 )
+			printf( "  depth %2d: %8.1f (%d positions)\n", d, (double) depthTime[ d ] / depthCount[ d ], depthCount[ d ] );
+
+	printf( "\nPositions: %d\n", index );
+	printf( "Nodes:     %lld\n", totalNodes );
+	printf( "Time:      %ld ms\n", totalTime );
+	printf( "NPS:       %lld\n", totalNodes * 1000 / ( totalTime > 0 ? totalTime : 1 ) );
+	printf( "Checksum:  %016llx\n", (unsigned long long) checksum );
+
+	return 0;
+}
+
+/**********************************************************/
+
+// --- Main ---
+int main( int argc, char ** argv )
+{
+	int c;
+	int generate = 0;
+	opterr = 0;
+
+	// a fixed depth and no clock, node counts are reproducible with one thread
+	searchConfig.moveTime = 0;
+	searchConfig.maxDepth = DEFAULT_BENCH_DEPTH;
+
+	while( ( c = getopt ( argc, argv, "f:d:t:m:w:g:h" ) ) != -1 )
+		switch( c )
+		{
+			case 'h':
+				printf( "[-f positions_file] [-d depth] [-t threads] [-m hash_table_MB] [-w weights_file] [-g generate_count]\n" );
+				return 0;
+			case 'f':
+				positionsFile = optarg;
+				break;
+			case 'd':
+				searchConfig.maxDepth = atoi( optarg );
+				if( searchConfig.maxDepth < 1 || searchConfig.maxDepth > MAX_SEARCH_DEPTH )
+				{
+					printf( "Depth must be between 1 and %d\n", MAX_SEARCH_DEPTH );
+					return 1;
+				}
+				break;
+			case 't':
+				searchConfig.threads = atoi( optarg );
+				if( searchConfig.threads < 1 || searchConfig.threads > MAX_THREADS )
+				{
+					printf( "Threads must be between 1 and %d\n", MAX_THREADS );
+					return 1;
+				}
+				break;
+			case 'm':
+				hashMegabytes = atoi( optarg );
+				break;
+			case 'w':
+				weightsFile = optarg;
+				break;
+			case 'g':
+				generate = atoi( optarg );
+				break;
+			case '?':
+				if( optopt == 'f' || optopt == 'd' || optopt == 't' || optopt == 'm' || optopt == 'w' || optopt == 'g' )
+					printf( "Option -%c requires an argument.\n", ( char ) optopt );
+				else if( isprint( optopt ) )
+					printf( "Unknown option -%c\n", ( char ) optopt );
+				else
+					printf( "Unknown option character -%c\n", ( char ) optopt );
+				return 1;
+			default:
+			return 1;
+		}
+
+	initBoardTables();
+
+	if( generate > 0 )
+		return generatePositions( generate ) == 0 ? 0 : 1;
+
+	initPatterns();
+	initSearch();
+
+	if( weightsFile != NULL && loadEvaluationWeights( weightsFile ) < 0 )
+		return 1;
+
+	if( initTranspositionTable( hashMegabytes ) < 0 )
+		return 1;
+
+	return runBenchmark() == 0 ? 0 : 1;
+}
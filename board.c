@@ -2,6 +2,43 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+
+
+/**********************************************************/
+Bitboard playableCells;
+
+const int directionShift[ 6 ] = { -BIT_ROW_STRIDE, -BIT_ROW_STRIDE + 1, -1, 1, BIT_ROW_STRIDE - 1, BIT_ROW_STRIDE };
+static const signed char directionRow[ 6 ] = { -1, -1, 0, 0, 1, 1 };
+static const signed char directionCol[ 6 ] = { 0, 1, -1, 1, -1, 0 };
+
+unsigned char rayCells[ BITBOARD_WORDS * 64 ][ 6 ][ MAX_RAY_LENGTH ];
+unsigned char rayLength[ BITBOARD_WORDS * 64 ][ 6 ];
+
+/* The three axes: rows, columns and the ( 1, -1 ) diagonals (a direction and its opposite each), the cells at
+   an end of a line of every axis (at the edge or next to an ILLEGAL tile) and the lines of the diagonal axis */
+#define AXIS_ROW 0
+#define AXIS_COLUMN 1
+#define AXIS_DIAGONAL 2
+static const int axisForward[ 3 ] = { 3, 5, 4 };
+static const int axisBackward[ 3 ] = { 2, 0, 1 };
+static Bitboard lineEnds[ 3 ];
+static Bitboard diagonalLines[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE ];
+static int diagonalLineCount;
+
+/* one bit per 16-bit row of a word */
+#define ROW_STARTS 0x0001000100010001ULL
+
+uint64_t zobristDisc[ 2 ][ BITBOARD_WORDS * 64 ];
+uint64_t zobristTurn;
+
+int symmetryCount;
+unsigned char symmetryCell[ MAX_SYMMETRIES ][ BITBOARD_WORDS * 64 ];
+unsigned char inverseSymmetryCell[ MAX_SYMMETRIES ][ BITBOARD_WORDS * 64 ];
+
+/* zobristDisc seen through each symmetry, and the key change of flipping a disc on a cell */
+static uint64_t zobristSymmetric[ MAX_SYMMETRIES ][ 2 ][ BITBOARD_WORDS * 64 ];
+static uint64_t zobristFlip[ MAX_SYMMETRIES ][ BITBOARD_WORDS * 64 ];
 
 
 
@@ -103,40 +140,26 @@ void printPosition( Position * pos )
 }
 
 /**********************************************************/
-int doOneDirection( Position * pos, Move * moveToPlay, int do_move, signed char inc_row, signed char inc_col )
+/* walks the precomputed ray of the move's cell in direction d (see rayCells) */
+static int doRay( Position * pos, Move * moveToPlay, int do_move, int d )
 {
-	unsigned short int i,j;
-	unsigned short int opponent;
+	int origin, length, k, n;
+	unsigned char * ray;
+	char opponent;
 
 	opponent = getOtherSide( moveToPlay->color );
 
-	/* Quick rejects - are we too close to the borders? */
-	if((inc_row == -1 && moveToPlay->tile[ 0 ] < 2) || (inc_row == 1  && moveToPlay->tile[ 0 ] >= ARRAY_BOARD_SIZE-2))
-		return FALSE;
-	if((inc_col == -1 && moveToPlay->tile[ 1 ] < 2) || (inc_col == 1  && moveToPlay->tile[ 1 ] >= ARRAY_BOARD_SIZE-2))
-		return FALSE;
-
-	i = moveToPlay->tile[ 0 ] + inc_row; 
-	j = moveToPlay->tile[ 1 ] + inc_col;
-
-	/* The adjacent square must be in the opposite color. */
-	if( pos->board[ i ][ j ] != opponent )
-		return FALSE;
+	origin = BIT_INDEX( moveToPlay->tile[ 0 ], moveToPlay->tile[ 1 ] );
+	ray = rayCells[ origin ][ d ];
+	length = rayLength[ origin ][ d ];
 
 	/* Go over all the consecutive squares in the opponents color */
-	do
-	{
-		i += inc_row; 
-		j += inc_col;
-		if( i<0 || i>=ARRAY_BOARD_SIZE || j<0 || j>=ARRAY_BOARD_SIZE)
+	for( k = 0; k < length; k++ )
+		if( pos->board[ BIT_ROW( ray[ k ] ) ][ BIT_COL( ray[ k ] ) ] != opponent )
 			break;
-		if(pos->board[ i ][ j ] !=opponent)
-			break;
-	}
-	while(1);
 
-	/* Have we reached the end of the board or not a piece of ours (failure)? */
-	if(i < 0 || i >= ARRAY_BOARD_SIZE || j < 0 || j >= ARRAY_BOARD_SIZE || pos->board[ i ][ j ]!=moveToPlay->color)
+	/* No opponent piece, reached the edge of the board or not a piece of ours (failure)? */
+	if( k == 0 || k == length || pos->board[ BIT_ROW( ray[ k ] ) ][ BIT_COL( ray[ k ] ) ] != moveToPlay->color )
 		return FALSE;
 
 	/* If we have reached here, then we have a legal move !!! */
@@ -144,21 +167,33 @@ int doOneDirection( Position * pos, Move * moveToPlay, int do_move, signed char
 		return TRUE;
 
 	/* Flip the other side pieces */
-	for (i-=inc_row, j-=inc_col; i != moveToPlay->tile[ 0 ] || j != moveToPlay->tile[ 1 ]; i-=inc_row, j-=inc_col) 
-	{
-		pos->board[ i ][ j ] = moveToPlay->color;
-		pos->score[ (int) moveToPlay->color ]++;
-		pos->score[ opponent ]--;
-	}
+	for( n = 0; n < k; n++ )
+		pos->board[ BIT_ROW( ray[ n ] ) ][ BIT_COL( ray[ n ] ) ] = moveToPlay->color;
+
+	pos->score[ ( int ) moveToPlay->color ] += k;
+	pos->score[ ( int ) opponent ] -= k;
 
 	return TRUE;
 
 }
 
+/**********************************************************/
+int doOneDirection( Position * pos, Move * moveToPlay, int do_move, signed char inc_row, signed char inc_col )
+{
+	int d;
+
+	for( d = 0; d < 6; d++ )
+		if( directionRow[ d ] == inc_row && directionCol[ d ] == inc_col )
+			return doRay( pos, moveToPlay, do_move, d );
+
+	return FALSE;
+
+}
+
 /**********************************************************/
 int doAllDirections( Position * pos, Move * moveToPlay, int do_move )
 {
-	short int i,j;
+	int d;
 	int legal = FALSE; /* Was the move found to be legal already? */
 
 
@@ -169,18 +204,15 @@ int doAllDirections( Position * pos, Move * moveToPlay, int do_move )
 		return TRUE;
 	}
 
-	for (i=-1 ; i <= 1 ; i++)
-		for (j=-1 ; j <= 1 ; j++)
-		{
-			if (j == i)
-				continue;
-			if(doOneDirection( pos, moveToPlay, do_move, i, j))
-				legal = TRUE;
+	for (d=0 ; d < 6 ; d++)
+	{
+		if(doRay( pos, moveToPlay, do_move, d))
+			legal = TRUE;
 
-			/* If we found something legal it may be enough ... */
-			if (legal && !do_move)
-				return TRUE;
-		}
+		/* If we found something legal it may be enough ... */
+		if (legal && !do_move)
+			return TRUE;
+	}
 
 	/* Put the piece in its place */
 	if(legal && do_move) {
@@ -236,6 +268,528 @@ int canMove( Position * pos, char color)
 }
 
 
+/**********************************************************/
+/* Bitboard representation */
+
+/**********************************************************/
+/* splitmix64: the same sequence for a seed on every machine and in every process */
+uint64_t nextRandom( uint64_t * state )
+{
+	uint64_t z = ( *state += 0x9E3779B97F4A7C15ULL );
+
+	z = ( z ^ ( z >> 30 ) ) * 0xBF58476D1CE4E5B9ULL;
+	z = ( z ^ ( z >> 27 ) ) * 0x94D049BB133111EBULL;
+	return z ^ ( z >> 31 );
+}
+
+/**********************************************************/
+void initBoardTables( void )
+{
+	Position pos;
+	int i, j, d, row, col, a, k;
+	uint64_t seed = 0x48657854686C6CULL;
+
+	initPosition( &pos );		//the shape of the board is defined there only
+
+	memset( &playableCells, 0, sizeof( Bitboard ) );
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			if( pos.board[ i ][ j ] != OUT_OF_BOUND && pos.board[ i ][ j ] != ILLEGAL )
+				bbSetBit( &playableCells, BIT_INDEX( i, j ) );
+
+	/* rays */
+	memset( rayLength, 0, sizeof( rayLength ) );
 
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			for( d = 0; d < 6; d++ )
+			{
+				for( row = i + directionRow[ d ], col = j + directionCol[ d ]; row >= 0 && row < ARRAY_BOARD_SIZE && col >= 0 && col < ARRAY_BOARD_SIZE; row += directionRow[ d ], col += directionCol[ d ] )
+				{
+					if( !bbTestBit( playableCells, BIT_INDEX( row, col ) ) )
+						break;
+					rayCells[ BIT_INDEX( i, j ) ][ d ][ rayLength[ BIT_INDEX( i, j ) ][ d ]++ ] = BIT_INDEX( row, col );
+				}
+			}
+
+	/* ends of the lines of every axis, and the diagonal lines (each starts at a cell with no playable cell behind it) */
+	diagonalLineCount = 0;
 
+	for( a = 0; a < 3; a++ )
+	{
+		memset( &lineEnds[ a ], 0, sizeof( Bitboard ) );
 
+		for( i = 0; i < BITBOARD_WORDS * 64; i++ )
+		{
+			Bitboard * line;
+
+			if( !bbTestBit( playableCells, i ) )
+				continue;
+
+			if( rayLength[ i ][ axisForward[ a ] ] == 0 || rayLength[ i ][ axisBackward[ a ] ] == 0 )
+				bbSetBit( &lineEnds[ a ], i );
+
+			if( a != AXIS_DIAGONAL || rayLength[ i ][ axisBackward[ a ] ] != 0 )
+				continue;
+
+			line = &diagonalLines[ diagonalLineCount++ ];
+			memset( line, 0, sizeof( Bitboard ) );
+			bbSetBit( line, i );
+
+			for( k = 0; k < rayLength[ i ][ axisForward[ a ] ]; k++ )
+				bbSetBit( line, rayCells[ i ][ axisForward[ a ] ][ k ] );
+		}
+	}
+
+	/* Zobrist keys */
+	for( i = 0; i < BITBOARD_WORDS * 64; i++ )
+	{
+		zobristDisc[ WHITE ][ i ] = nextRandom( &seed );
+		zobristDisc[ BLACK ][ i ] = nextRandom( &seed );
+	}
+	zobristTurn = nextRandom( &seed );
+
+	/* Symmetries: the 6 rotations, with and without a reflection, in cube coordinates
+	( x, y, z ) = ( col - radius, -x - z, row - radius ). A rotation by 60 degrees is
+	( x, y, z ) -> ( -z, -x, -y ), the reflection swaps y and z. Kept are those that
+	leave initPosition() as it is (the identity comes first) */
+	symmetryCount = 0;
+
+	for( int reflect = 0; reflect < 2; reflect++ )
+		for( int rotate = 0; rotate < 6; rotate++ )
+		{
+			int s = symmetryCount, valid = TRUE;
+
+			for( i = 0; i < BITBOARD_WORDS * 64; i++ )
+				symmetryCell[ s ][ i ] = i;
+
+			for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+				for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+				{
+					int x = j - HEX_BOARD_RADIUS, z = i - HEX_BOARD_RADIUS, y = -x - z, t;
+
+					if( pos.board[ i ][ j ] == OUT_OF_BOUND )
+						continue;
+
+					if( reflect )
+					{
+						t = y; y = z; z = t;
+					}
+					for( d = 0; d < rotate; d++ )
+					{
+						t = x; x = -z; z = -y; y = -t;
+					}
+
+					row = z + HEX_BOARD_RADIUS;
+					col = x + HEX_BOARD_RADIUS;
+					symmetryCell[ s ][ BIT_INDEX( i, j ) ] = BIT_INDEX( row, col );
+
+					if( pos.board[ row ][ col ] != pos.board[ i ][ j ] )
+						valid = FALSE;
+				}
+
+			if( !valid )
+				continue;
+
+			for( i = 0; i < BITBOARD_WORDS * 64; i++ )
+			{
+				inverseSymmetryCell[ s ][ symmetryCell[ s ][ i ] ] = i;
+				zobristSymmetric[ s ][ WHITE ][ i ] = zobristDisc[ WHITE ][ symmetryCell[ s ][ i ] ];
+				zobristSymmetric[ s ][ BLACK ][ i ] = zobristDisc[ BLACK ][ symmetryCell[ s ][ i ] ];
+				zobristFlip[ s ][ i ] = zobristSymmetric[ s ][ WHITE ][ i ] ^ zobristSymmetric[ s ][ BLACK ][ i ];
+			}
+			symmetryCount++;
+		}
+}
+
+/**********************************************************/
+/* the smallest key names the position and all its symmetric twins */
+static void setCanonicalHash( BitPosition * pos )
+{
+	int s;
+
+	pos->hash = pos->symmetricHash[ 0 ];
+	pos->symmetry = 0;
+
+	for( s = 1; s < symmetryCount; s++ )
+		if( pos->symmetricHash[ s ] < pos->hash )
+		{
+			pos->hash = pos->symmetricHash[ s ];
+			pos->symmetry = s;
+		}
+}
+
+/**********************************************************/
+void computeHash( BitPosition * pos )
+{
+	Bitboard discs;
+	int s, color, index;
+
+	for( s = 0; s < symmetryCount; s++ )
+	{
+		pos->symmetricHash[ s ] = ( pos->turn == BLACK ) ? zobristTurn : 0;
+
+		for( color = WHITE; color <= BLACK; color++ )
+			for( discs = pos->disc[ color ]; !bbIsEmpty( discs ); bbClearBit( &discs, index ) )
+			{
+				index = bbLowestBit( discs );
+				pos->symmetricHash[ s ] ^= zobristSymmetric[ s ][ color ][ index ];
+			}
+	}
+
+	setCanonicalHash( pos );
+}
+
+/**********************************************************/
+/* key change of color playing on index and flipping flips (turn change included), for every symmetry */
+static void updateHash( BitPosition * pos, Bitboard flips, int index, char color )
+{
+	int s, k;
+
+	for( s = 0; s < symmetryCount; s++ )
+		pos->symmetricHash[ s ] ^= zobristTurn ^ zobristSymmetric[ s ][ ( int ) color ][ index ];
+
+	for( k = 0; k < BITBOARD_WORDS; k++ )
+		while( flips.word[ k ] )
+		{
+			int cell = k * 64 + __builtin_ctzll( flips.word[ k ] );
+
+			for( s = 0; s < symmetryCount; s++ )
+				pos->symmetricHash[ s ] ^= zobristFlip[ s ][ cell ];
+			flips.word[ k ] &= flips.word[ k ] - 1;
+		}
+
+	setCanonicalHash( pos );
+}
+
+/**********************************************************/
+/* a pass only changes the turn */
+static void updateHashForPass( BitPosition * pos )
+{
+	int s;
+
+	for( s = 0; s < symmetryCount; s++ )
+		pos->symmetricHash[ s ] ^= zobristTurn;
+
+	setCanonicalHash( pos );
+}
+
+/**********************************************************/
+void transformPosition( Position * pos, int symmetry, Position * transformed )
+{
+	int i, j, cell;
+
+	*transformed = *pos;
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+		{
+			cell = symmetryCell[ symmetry ][ BIT_INDEX( i, j ) ];
+			transformed->board[ BIT_ROW( cell ) ][ BIT_COL( cell ) ] = pos->board[ i ][ j ];
+		}
+}
+
+/**********************************************************/
+void positionToBitPosition( Position * pos, BitPosition * bitPos )
+{
+	int i, j;
+
+	memset( bitPos, 0, sizeof( BitPosition ) );
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			if( pos->board[ i ][ j ] == WHITE || pos->board[ i ][ j ] == BLACK )
+				bbSetBit( &bitPos->disc[ ( int ) pos->board[ i ][ j ] ], BIT_INDEX( i, j ) );
+
+	bitPos->turn = pos->turn;
+	computeHash( bitPos );
+}
+
+/**********************************************************/
+void bitPositionToPosition( BitPosition * bitPos, Position * pos )
+{
+	int i, j;
+
+	initPosition( pos );
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+		{
+			if( bbTestBit( bitPos->disc[ WHITE ], BIT_INDEX( i, j ) ) )
+				pos->board[ i ][ j ] = WHITE;
+			else if( bbTestBit( bitPos->disc[ BLACK ], BIT_INDEX( i, j ) ) )
+				pos->board[ i ][ j ] = BLACK;
+			else if( pos->board[ i ][ j ] == WHITE || pos->board[ i ][ j ] == BLACK )
+				pos->board[ i ][ j ] = EMPTY;
+		}
+
+	pos->score[ WHITE ] = bitScore( bitPos, WHITE );
+	pos->score[ BLACK ] = bitScore( bitPos, BLACK );
+	pos->turn = bitPos->turn;
+}
+
+/**********************************************************/
+Bitboard generateMoves( BitPosition * pos, char color )
+{
+	Bitboard own = pos->disc[ ( int ) color ];
+	Bitboard opponent = pos->disc[ getOtherSide( color ) ];
+	Bitboard empty = bbEmptyCells( pos );
+	Bitboard moves = { { 0 } };
+	Bitboard run, frontier;
+	int d;
+
+	for( d = 0; d < 6; d++ )
+	{
+		/* every opponent disc reachable from one of ours through a run of opponent discs.. */
+		run = bbAnd( bbShift( own, directionShift[ d ] ), opponent );
+		frontier = run;
+
+		while( !bbIsEmpty( frontier ) )
+		{
+			frontier = bbAnd( bbShift( frontier, directionShift[ d ] ), opponent );
+			run = bbOr( run, frontier );
+		}
+
+		/* ..and an empty cell right after the run is a legal move (looking back at our disc) */
+		moves = bbOr( moves, bbAnd( bbShift( run, directionShift[ d ] ), empty ) );
+	}
+
+	return moves;
+}
+
+/**********************************************************/
+void computeMobility( BitPosition * pos, Mobility * mobility )
+{
+	Bitboard empty = bbEmptyCells( pos );
+	Bitboard moves[ 2 ] = { { { 0 } }, { { 0 } } };
+	Bitboard nextToEmpty = { { 0 } };
+	Bitboard nextToDisc[ 2 ] = { { { 0 } }, { { 0 } } };
+	Bitboard run, frontier;
+	int d, color;
+
+	for( d = 0; d < 6; d++ )
+	{
+		nextToEmpty = bbOr( nextToEmpty, bbShift( empty, directionShift[ d ] ) );
+
+		for( color = WHITE; color <= BLACK; color++ )
+		{
+			Bitboard opponent = pos->disc[ getOtherSide( color ) ];
+
+			nextToDisc[ color ] = bbOr( nextToDisc[ color ], bbShift( pos->disc[ color ], directionShift[ d ] ) );
+
+			/* same propagation as generateMoves() */
+			run = bbAnd( bbShift( pos->disc[ color ], directionShift[ d ] ), opponent );
+			frontier = run;
+
+			while( !bbIsEmpty( frontier ) )
+			{
+				frontier = bbAnd( bbShift( frontier, directionShift[ d ] ), opponent );
+				run = bbOr( run, frontier );
+			}
+
+			moves[ color ] = bbOr( moves[ color ], bbShift( run, directionShift[ d ] ) );
+		}
+	}
+
+	for( color = WHITE; color <= BLACK; color++ )
+	{
+		mobility->moves[ color ] = bbPopCount( bbAnd( moves[ color ], empty ) );
+		mobility->frontier[ color ] = bbPopCount( bbAnd( pos->disc[ color ], nextToEmpty ) );
+		mobility->potential[ color ] = bbPopCount( bbAnd( empty, nextToDisc[ getOtherSide( color ) ] ) );
+	}
+}
+
+/**********************************************************/
+void computeStableDiscs( BitPosition * pos, Bitboard stable[ 2 ] )
+{
+	Bitboard empty = bbEmptyCells( pos );
+	Bitboard safe[ 3 ], previous;
+	uint64_t columns = 0;
+	int a, k, color;
+
+	/* along an axis, a disc can't be flipped if it ends its line or if its line has no empty cell left.
+	   Rows and columns are checked a word at a time (a whole row or column counts as one line,
+	   so a line cut by an ILLEGAL tile is only seen full when the rest of it is full too) */
+	for( k = 0; k < BITBOARD_WORDS; k++ )
+	{
+		uint64_t rows = empty.word[ k ];
+
+		/* afterwards bit 16 * r is set if row r of the word has an empty cell */
+		rows |= rows >> 8;
+		rows |= rows >> 4;
+		rows |= rows >> 2;
+		rows |= rows >> 1;
+
+		safe[ AXIS_ROW ].word[ k ] = ( ( ~rows & ROW_STARTS ) * 0xFFFF ) & playableCells.word[ k ];
+		columns |= empty.word[ k ];
+	}
+
+	columns |= columns >> 32;
+	columns |= columns >> 16;
+	for( k = 0; k < BITBOARD_WORDS; k++ )
+		safe[ AXIS_COLUMN ].word[ k ] = ( ( ~columns & 0xFFFF ) * ROW_STARTS ) & playableCells.word[ k ];
+
+	memset( &safe[ AXIS_DIAGONAL ], 0, sizeof( Bitboard ) );
+	for( k = 0; k < diagonalLineCount; k++ )
+		if( bbIsEmpty( bbAnd( diagonalLines[ k ], empty ) ) )
+			safe[ AXIS_DIAGONAL ] = bbOr( safe[ AXIS_DIAGONAL ], diagonalLines[ k ] );
+
+	for( a = 0; a < 3; a++ )
+		safe[ a ] = bbOr( safe[ a ], lineEnds[ a ] );
+
+	/* nor if a neighbour along it is a stable disc of the same color: any flip there would flip the neighbour too.
+	   A disc safe along all three axes is stable, the stable set grows until it stops changing */
+	for( color = WHITE; color <= BLACK; color++ )
+	{
+		memset( &stable[ color ], 0, sizeof( Bitboard ) );
+
+		do
+		{
+			previous = stable[ color ];
+			stable[ color ] = pos->disc[ color ];
+
+			for( a = 0; a < 3; a++ )
+			{
+				int shift = directionShift[ axisForward[ a ] ];
+
+				stable[ color ] = bbAnd( stable[ color ], bbOr( safe[ a ], bbOr( bbShift( previous, shift ), bbShift( previous, -shift ) ) ) );
+			}
+		} while( !bbIsEmpty( bbXor( stable[ color ], previous ) ) );
+	}
+}
+
+/**********************************************************/
+Bitboard computeFlips( BitPosition * pos, int index, char color )
+{
+	Bitboard own = pos->disc[ ( int ) color ];
+	Bitboard opponent = pos->disc[ getOtherSide( color ) ];
+	Bitboard flips = { { 0 } };
+	unsigned char * ray;
+	int d, k, n;
+
+	for( d = 0; d < 6; d++ )
+	{
+		ray = rayCells[ index ][ d ];
+
+		/* Go over all the consecutive discs in the opponents color */
+		for( k = 0; k < rayLength[ index ][ d ] && bbTestBit( opponent, ray[ k ] ); k++ );
+
+		if( k == 0 || k == rayLength[ index ][ d ] || !bbTestBit( own, ray[ k ] ) )
+			continue;
+
+		for( n = 0; n < k; n++ )
+			bbSetBit( &flips, ray[ n ] );
+	}
+
+	return flips;
+}
+
+/**********************************************************/
+void doBitMove( BitPosition * pos, Move * moveToDo )
+{
+	Bitboard flips;
+	int index;
+
+	/*null move?*/
+	if( moveToDo->tile[ 0 ] == NULL_MOVE )
+	{
+		pos->turn = getOtherSide( pos->turn );
+		updateHashForPass( pos );
+		return;
+	}
+
+	index = BIT_INDEX( moveToDo->tile[ 0 ], moveToDo->tile[ 1 ] );
+	flips = computeFlips( pos, index, moveToDo->color );
+
+	if( bbIsEmpty( flips ) )
+		return;
+
+	/* Flip the other side pieces and put the piece in its place */
+	pos->disc[ ( int ) moveToDo->color ] = bbOr( pos->disc[ ( int ) moveToDo->color ], flips );
+	pos->disc[ getOtherSide( moveToDo->color ) ] = bbAndNot( pos->disc[ getOtherSide( moveToDo->color ) ], flips );
+	bbSetBit( &pos->disc[ ( int ) moveToDo->color ], index );
+	pos->turn = getOtherSide( pos->turn );
+	updateHash( pos, flips, index, moveToDo->color );
+}
+
+/**********************************************************/
+int isLegalBitMove( BitPosition * pos, Move * moveToCheck )
+{
+	int index;
+
+	if(moveToCheck->tile[ 0 ] < 0 || moveToCheck->tile[ 0 ] >= ARRAY_BOARD_SIZE || moveToCheck->tile[ 1 ] < 0 || moveToCheck->tile[ 1 ] >= ARRAY_BOARD_SIZE)
+		return FALSE;
+
+	index = BIT_INDEX( moveToCheck->tile[ 0 ], moveToCheck->tile[ 1 ] );
+
+	if( !bbTestBit( bbEmptyCells( pos ), index ) )
+		return FALSE;
+
+	return !bbIsEmpty( computeFlips( pos, index, moveToCheck->color ) );
+}
+
+/**********************************************************/
+int canBitMove( BitPosition * pos, char color )
+{
+	return !bbIsEmpty( generateMoves( pos, color ) );
+}
+
+/**********************************************************/
+int makeMove( BitPosition * pos, Move * moveToDo, UndoStack * stack )
+{
+	UndoRecord * record;
+
+	assert( stack->top < MAX_UNDO_DEPTH );
+
+	record = &stack->record[ stack->top++ ];
+	record->color = moveToDo->color;
+	record->turn = pos->turn;
+	memcpy( record->symmetricHash, pos->symmetricHash, symmetryCount * sizeof( uint64_t ) );
+	record->index = NULL_MOVE;
+
+	/*null move?*/
+	if( moveToDo->tile[ 0 ] == NULL_MOVE )
+	{
+		memset( &record->flips, 0, sizeof( Bitboard ) );
+		pos->turn = getOtherSide( pos->turn );
+		updateHashForPass( pos );
+		return TRUE;
+	}
+
+	record->flips = computeFlips( pos, BIT_INDEX( moveToDo->tile[ 0 ], moveToDo->tile[ 1 ] ), moveToDo->color );
+
+	if( bbIsEmpty( record->flips ) )
+		return FALSE;
+
+	record->index = BIT_INDEX( moveToDo->tile[ 0 ], moveToDo->tile[ 1 ] );
+
+	pos->disc[ ( int ) moveToDo->color ] = bbOr( pos->disc[ ( int ) moveToDo->color ], record->flips );
+	pos->disc[ getOtherSide( moveToDo->color ) ] = bbXor( pos->disc[ getOtherSide( moveToDo->color ) ], record->flips );
+	bbSetBit( &pos->disc[ ( int ) moveToDo->color ], record->index );
+	pos->turn = getOtherSide( pos->turn );
+	updateHash( pos, record->flips, record->index, moveToDo->color );
+
+	return TRUE;
+}
+
+/**********************************************************/
+void unmakeMove( BitPosition * pos, UndoStack * stack )
+{
+	UndoRecord * record;
+
+	assert( stack->top > 0 );
+
+	record = &stack->record[ --stack->top ];
+
+	if( record->index != NULL_MOVE )
+	{
+		bbClearBit( &pos->disc[ ( int ) record->color ], record->index );
+		pos->disc[ ( int ) record->color ] = bbXor( pos->disc[ ( int ) record->color ], record->flips );
+		pos->disc[ getOtherSide( record->color ) ] = bbOr( pos->disc[ getOtherSide( record->color ) ], record->flips );
+	}
+
+	pos->turn = record->turn;
+	memcpy( pos->symmetricHash, record->symmetricHash, symmetryCount * sizeof( uint64_t ) );
+	setCanonicalHash( pos );
+}
@@ -3,6 +3,7 @@
 
 #include "global.h"
 #include "move.h"
+#include <stdint.h>
 /**********************************************************/
 
 /* Position struct to store board, score and player's turn */
@@ -43,4 +44,234 @@ int isLegal( Position * pos, short int row, short int col, char color);
 int canMove( Position * pos, char color);
 //checks if player (color) can move on that specific position.
 
+
+/**********************************************************/
+/* Bitboard representation (used by the agent's search) */
+
+/* cell ( i, j ) of the array board is bit ( i * BIT_ROW_STRIDE + j ). The 16th column never holds a
+   playable cell, so a shift by one row/column that wraps around lands on padding and gets masked out */
+#define BIT_ROW_STRIDE 16
+#define BITBOARD_WORDS 4
+#define BIT_INDEX( row, col ) ( ( row ) * BIT_ROW_STRIDE + ( col ) )
+#define BIT_ROW( index ) ( ( index ) / BIT_ROW_STRIDE )
+#define BIT_COL( index ) ( ( index ) % BIT_ROW_STRIDE )
+
+/* 256-bit set of cells */
+typedef struct
+{
+	uint64_t word[ BITBOARD_WORDS ];
+} Bitboard;
+
+/* rotations and reflections of the hexagon, only those that map initPosition() onto itself are used */
+#define MAX_SYMMETRIES 12
+
+/* Compact position: one occupancy set per color (scores are popcounts) */
+typedef struct
+{
+	Bitboard disc[ 2 ];
+	uint64_t hash;											//canonical key: the smallest of symmetricHash[], the same for all symmetric positions
+	uint64_t symmetricHash[ MAX_SYMMETRIES ];				//Zobrist key of discs and turn seen through each symmetry ([ 0 ] is the identity)
+	char symmetry;											//the one that gives hash, moves stored under hash are in its frame
+	char turn;												//stores the color of the player that has the turn
+} BitPosition;
+
+/* Mobility terms of both colors, see computeMobility() */
+typedef struct
+{
+	int moves[ 2 ];											//number of legal moves
+	int frontier[ 2 ];										//discs next to at least one empty cell
+	int potential[ 2 ];										//empty cells next to at least one opponent disc
+} Mobility;
+
+/* Undo information of one makeMove(), pushed on an UndoStack so that unmakeMove() can restore the position */
+typedef struct
+{
+	Bitboard flips;											//discs that changed color (their count is the score delta)
+	short int index;										//bit index of the placed disc, NULL_MOVE if nothing was placed
+	uint64_t symmetricHash[ MAX_SYMMETRIES ];				//keys before the move (the canonical one is recomputed)
+	char color;
+	char turn;												//turn before the move
+} UndoRecord;
+
+/* a search ply can never exceed two plies per playable cell (a move and a pass) */
+#define MAX_UNDO_DEPTH ( 2 * ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE )
+
+typedef struct
+{
+	UndoRecord record[ MAX_UNDO_DEPTH ];
+	int top;
+} UndoStack;
+
+extern Bitboard playableCells;			//cells of the hexagon that can hold a disc (no OUT_OF_BOUND/ILLEGAL tiles)
+
+/* offsets of the six hex directions (-1,0) (-1,1) (0,-1) (0,1) (1,-1) (1,0) in bit indices */
+extern const int directionShift[ 6 ];
+
+/* rayCells[ c ][ d ] lists (as bit indices) the playable cells met walking from cell c in direction d,
+   nearest first, up to the edge of the hexagon. Built by initBoardTables() */
+#define MAX_RAY_LENGTH ( ARRAY_BOARD_SIZE - 1 )
+extern unsigned char rayCells[ BITBOARD_WORDS * 64 ][ 6 ][ MAX_RAY_LENGTH ];
+extern unsigned char rayLength[ BITBOARD_WORDS * 64 ][ 6 ];
+
+/* Zobrist keys: one per color and cell, plus one xor-ed in while BLACK has the turn */
+extern uint64_t zobristDisc[ 2 ][ BITBOARD_WORDS * 64 ];
+extern uint64_t zobristTurn;
+
+/* symmetryCell[ s ][ c ] is where symmetry s takes cell c (bit indices, cells off the board stay put),
+   inverseSymmetryCell takes it back. Symmetry 0 is the identity */
+extern int symmetryCount;
+extern unsigned char symmetryCell[ MAX_SYMMETRIES ][ BITBOARD_WORDS * 64 ];
+extern unsigned char inverseSymmetryCell[ MAX_SYMMETRIES ][ BITBOARD_WORDS * 64 ];
+
+
+// --- Cells of moves stored under the canonical key (tables, book) are kept in the canonical frame ---
+static inline int toCanonicalCell( BitPosition * pos, int index )
+{
+	return symmetryCell[ ( int ) pos->symmetry ][ index ];
+}
+
+static inline int fromCanonicalCell( BitPosition * pos, int index )
+{
+	return inverseSymmetryCell[ ( int ) pos->symmetry ][ index ];
+}
+
+static inline Bitboard bbAnd( Bitboard a, Bitboard b )
+{
+	for( int k = 0; k < BITBOARD_WORDS; k++ ) a.word[ k ] &= b.word[ k ];
+	return a;
+}
+
+static inline Bitboard bbOr( Bitboard a, Bitboard b )
+{
+	for( int k = 0; k < BITBOARD_WORDS; k++ ) a.word[ k ] |= b.word[ k ];
+	return a;
+}
+
+static inline Bitboard bbXor( Bitboard a, Bitboard b )
+{
+	for( int k = 0; k < BITBOARD_WORDS; k++ ) a.word[ k ] ^= b.word[ k ];
+	return a;
+}
+
+static inline Bitboard bbAndNot( Bitboard a, Bitboard b )
+{
+	for( int k = 0; k < BITBOARD_WORDS; k++ ) a.word[ k ] &= ~b.word[ k ];
+	return a;
+}
+
+static inline int bbIsEmpty( Bitboard a )
+{
+	return ( a.word[ 0 ] | a.word[ 1 ] | a.word[ 2 ] | a.word[ 3 ] ) == 0;
+}
+
+static inline int bbPopCount( Bitboard a )
+{
+	return __builtin_popcountll( a.word[ 0 ] ) + __builtin_popcountll( a.word[ 1 ] )
+		+ __builtin_popcountll( a.word[ 2 ] ) + __builtin_popcountll( a.word[ 3 ] );
+}
+
+static inline int bbTestBit( Bitboard a, int index )
+{
+	return ( a.word[ index >> 6 ] >> ( index & 63 ) ) & 1;
+}
+
+static inline void bbSetBit( Bitboard * a, int index )
+{
+	a->word[ index >> 6 ] |= 1ULL << ( index & 63 );
+}
+
+static inline void bbClearBit( Bitboard * a, int index )
+{
+	a->word[ index >> 6 ] &= ~( 1ULL << ( index & 63 ) );
+}
+
+//shifts every cell by n bit indices (n > 0 towards higher indices), |n| < 64
+static inline Bitboard bbShift( Bitboard a, int n )
+{
+	Bitboard r;
+
+	if( n > 0 )
+	{
+		r.word[ 3 ] = ( a.word[ 3 ] << n ) | ( a.word[ 2 ] >> ( 64 - n ) );
+		r.word[ 2 ] = ( a.word[ 2 ] << n ) | ( a.word[ 1 ] >> ( 64 - n ) );
+		r.word[ 1 ] = ( a.word[ 1 ] << n ) | ( a.word[ 0 ] >> ( 64 - n ) );
+		r.word[ 0 ] = a.word[ 0 ] << n;
+	}
+	else
+	{
+		n = -n;
+		r.word[ 0 ] = ( a.word[ 0 ] >> n ) | ( a.word[ 1 ] << ( 64 - n ) );
+		r.word[ 1 ] = ( a.word[ 1 ] >> n ) | ( a.word[ 2 ] << ( 64 - n ) );
+		r.word[ 2 ] = ( a.word[ 2 ] >> n ) | ( a.word[ 3 ] << ( 64 - n ) );
+		r.word[ 3 ] = a.word[ 3 ] >> n;
+	}
+
+	return r;
+}
+
+//index of the lowest set bit, a must not be empty
+static inline int bbLowestBit( Bitboard a )
+{
+	for( int k = 0; k < BITBOARD_WORDS; k++ )
+		if( a.word[ k ] )
+			return k * 64 + __builtin_ctzll( a.word[ k ] );
+	return -1;
+}
+
+static inline Bitboard bbEmptyCells( BitPosition * pos )
+{
+	return bbAndNot( playableCells, bbOr( pos->disc[ WHITE ], pos->disc[ BLACK ] ) );
+}
+
+static inline int bitScore( BitPosition * pos, char color )
+{
+	return bbPopCount( pos->disc[ ( int ) color ] );
+}
+
+
+uint64_t nextRandom( uint64_t * state );
+//next number of the pseudo random sequence (splitmix64) that *state is at, fixed for a fixed seed
+
+void initBoardTables( void );
+//builds the playable cell mask, the ray tables and the Zobrist keys, call once at startup (before any doMove)
+
+void computeHash( BitPosition * pos );
+//computes the Zobrist keys of a position from scratch (all symmetries and the canonical one)
+
+void transformPosition( Position * pos, int symmetry, Position * transformed );
+//the position seen through a symmetry (same score and turn)
+
+void positionToBitPosition( Position * pos, BitPosition * bitPos );
+//converts a received position to the bitboard representation
+
+void bitPositionToPosition( BitPosition * bitPos, Position * pos );
+//converts back (OUT_OF_BOUND/ILLEGAL tiles are restored from initPosition)
+
+Bitboard generateMoves( BitPosition * pos, char color );
+//returns the set of all legal moves of color, computed for all cells at once
+
+void computeMobility( BitPosition * pos, Mobility * mobility );
+//counts legal moves, frontier discs and potential mobility of both colors in a single pass over the six directions
+
+void computeStableDiscs( BitPosition * pos, Bitboard stable[ 2 ] );
+//finds the discs of each color that no sequence of moves can flip, grown from the ends of the lines along the three axes
+
+Bitboard computeFlips( BitPosition * pos, int index, char color );
+//returns the discs flipped by color playing on bit index (empty if the move is illegal)
+
+void doBitMove( BitPosition * pos, Move * moveToDo );
+//doMove() equivalent on a bit position
+
+int isLegalBitMove( BitPosition * pos, Move * moveToCheck );
+//isLegalMove() equivalent on a bit position
+
+int canBitMove( BitPosition * pos, char color );
+//canMove() equivalent on a bit position
+
+int makeMove( BitPosition * pos, Move * moveToDo, UndoStack * stack );
+//plays the move in place and pushes what is needed to take it back. Returns FALSE for an illegal move (position unchanged, still pushed)
+
+void unmakeMove( BitPosition * pos, UndoStack * stack );
+//takes back the last makeMove() of the stack
+
 #endif
@@ -0,0 +1,115 @@
+#include "book.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**********************************************************/
+static void * bookMap = NULL;			//the whole file
+static size_t bookSize;
+static BookEntry * bookEntries;			//inside the mapping
+static uint32_t bookCount = 0;
+
+/**********************************************************/
+int openBook( char * fileName )
+{
+	BookHeader * header;
+	struct stat status;
+	int fd;
+
+	closeBook();
+
+	if( ( fd = open( fileName, O_RDONLY ) ) < 0 )
+		return -1;
+
+	if( fstat( fd, &status ) < 0 || status.st_size < ( off_t ) sizeof( BookHeader ) )
+	{
+		close( fd );
+		printf( "ERROR: %s is not an opening book\n", fileName );
+		return -1;
+	}
+
+	bookSize = status.st_size;
+	bookMap = mmap( NULL, bookSize, PROT_READ, MAP_SHARED, fd, 0 );
+	close( fd );
+
+	if( bookMap == MAP_FAILED )
+	{
+		bookMap = NULL;
+		printf( "ERROR: Could not map %s\n", fileName );
+		return -1;
+	}
+
+	header = bookMap;
+	if( header->magic != BOOK_MAGIC || header->version != BOOK_VERSION || bookSize != sizeof( BookHeader ) + ( size_t ) header->count * sizeof( BookEntry ) )
+	{
+		printf( "ERROR: %s is not an opening book of this version\n", fileName );
+		closeBook();
+		return -1;
+	}
+
+	bookEntries = ( BookEntry * ) ( header + 1 );
+	bookCount = header->count;
+
+	//small enough to want all of it, probes then never wait for the disk
+	madvise( bookMap, bookSize, MADV_WILLNEED );
+
+	return 0;
+}
+
+/**********************************************************/
+int probeBook( Position * pos, Move * bookMove )
+{
+	BitPosition bitPos;
+	uint32_t low = 0, high = bookCount;
+
+	if( bookCount == 0 )
+		return FALSE;
+
+	positionToBitPosition( pos, &bitPos );
+
+	while( low < high )
+	{
+		uint32_t middle = low + ( high - low ) / 2;
+
+		if( bookEntries[ middle ].key < bitPos.hash )
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	if( low == bookCount || bookEntries[ low ].key != bitPos.hash )
+		return FALSE;
+
+	bookMove->color = pos->turn;
+	bookMove->tile[ 0 ] = BIT_ROW( fromCanonicalCell( &bitPos, bookEntries[ low ].move ) );
+	bookMove->tile[ 1 ] = BIT_COL( fromCanonicalCell( &bitPos, bookEntries[ low ].move ) );
+
+	//a key collision must never cost us the game
+	if( !isLegalMove( pos, bookMove ) )
+		return FALSE;
+
+	return TRUE;
+}
+
+/**********************************************************/
+void closeBook( void )
+{
+	if( bookMap != NULL )
+		munmap( bookMap, bookSize );
+
+	bookMap = NULL;
+	bookCount = 0;
+}
+
+/**********************************************************/
+int compareBookEntries( const void * a, const void * b )
+{
+	uint64_t keyA = ( ( const BookEntry * ) a )->key;
+	uint64_t keyB = ( ( const BookEntry * ) b )->key;
+
+	return keyA < keyB ? -1 : keyA > keyB;
+}
@@ -0,0 +1,46 @@
+#ifndef _BOOK_H
+#define _BOOK_H
+
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include <stdint.h>
+
+/**********************************************************/
+#define DEFAULT_BOOK_FILE "book.bin"
+
+#define BOOK_MAGIC 0x4B4F4F4278654800ULL		//"\0HexBOOK" in little endian byte order
+#define BOOK_VERSION 2
+
+/**********************************************************/
+/* File layout: the header, then count entries sorted by key (native byte order) */
+typedef struct
+{
+	uint64_t magic;
+	uint32_t version;
+	uint32_t count;
+} BookHeader;
+
+/* One position of the opening tree and the move a deep search chose there */
+typedef struct
+{
+	uint64_t key;			//canonical Zobrist key of the position (side to move included)
+	uint8_t move;			//bit index in the canonical frame (only positions with a choice are stored)
+	uint8_t depth;			//search depth
+	int16_t score;			//for the side to move
+	uint32_t reserved;
+} BookEntry;
+
+/**********************************************************/
+int openBook( char * fileName );
+//maps the book read-only (processes on one host share the pages), returns -1 and leaves no book if it is missing or malformed
+
+int probeBook( Position * pos, Move * bookMove );
+//returns TRUE and fills bookMove if the position is in the book (a binary search, no copy)
+
+void closeBook( void );
+
+int compareBookEntries( const void * a, const void * b );
+//qsort order of the entries in a book file
+
+#endif
@@ -0,0 +1,323 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "transposition.h"
+#include "pattern.h"
+#include "search.h"
+#include "book.h"
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <unistd.h>
+
+
+/**********************************************************/
+// every position reached in up to this many plies from initPosition() gets a book move (-p)
+#define DEFAULT_BOOK_PLIES 3
+
+// fixed search depth of every book position (-d)
+#define DEFAULT_BOOK_DEPTH 12
+
+#define DEFAULT_BOOK_TT_MEGABYTES 64
+
+// max() macro
+#define max(a, b) ((a > b) ? a : b)
+/**********************************************************/
+
+/* A position of the opening tree, with its key for sorting out transpositions */
+typedef struct
+{
+	uint64_t key;
+	Position position;
+	BitPosition bitPosition;			// its keys and the frame of its canonical key
+} TreeNode;
+
+char * bookFile = DEFAULT_BOOK_FILE;
+char * weightsFile = NULL;				// evaluation weights (built-in defaults if not given)
+
+int bookPlies = DEFAULT_BOOK_PLIES;
+int hashMegabytes = DEFAULT_BOOK_TT_MEGABYTES;
+int numberOfWorkers = 0;				// 0: one per online core
+
+TreeNode * nodes = NULL;
+int totalNodes = 0;
+int allocatedNodes = 0;
+
+BookEntry * entries = NULL;				// as the workers send them
+int received = 0;
+/**********************************************************/
+
+
+// --- Collect every position with a choice of moves up to the book depth (transpositions and symmetric twins are removed later) ---
+void expandTree( Position * pos, int ply )
+{
+	Position next;
+	Move move;
+	int i, j, total_moves = 0;
+
+	if( ply > bookPlies )
+		return;
+
+	move.color = pos->turn;
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			if( isLegal( pos, i, j, pos->turn ) )
+				total_moves++;
+
+	// a forced move or a pass costs the client nothing anyway
+	if( total_moves >= 2 )
+	{
+		BitPosition bitPos;
+
+		if( totalNodes == allocatedNodes )
+		{
+			allocatedNodes = allocatedNodes > 0 ? allocatedNodes * 2 : 1024;
+			if( ( nodes = realloc( nodes, allocatedNodes * sizeof( TreeNode ) ) ) == NULL )
+			{
+				printf( "ERROR: Out of memory\n" );
+				exit( 1 );
+			}
+		}
+
+		positionToBitPosition( pos, &bitPos );
+		nodes[ totalNodes ].key = bitPos.hash;
+		nodes[ totalNodes ].position = *pos;
+		nodes[ totalNodes ].bitPosition = bitPos;
+		totalNodes++;
+	}
+
+	if( total_moves == 0 )
+	{
+		// game over
+		if( !canMove( pos, getOtherSide( pos->turn ) ) )
+			return;
+
+		next = *pos;
+		move.tile[ 0 ] = NULL_MOVE;
+		doMove( &next, &move );
+		expandTree( &next, ply + 1 );
+		return;
+	}
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+		{
+			move.tile[ 0 ] = i;
+			move.tile[ 1 ] = j;
+
+			if( !isLegalMove( pos, &move ) )
+				continue;
+
+			next = *pos;
+			doMove( &next, &move );
+			expandTree( &next, ply + 1 );
+		}
+}
+
+// --- Sort the tree by key and keep one node per position ---
+int compareTreeNodes( const void * a, const void * b )
+{
+	uint64_t keyA = ( ( const TreeNode * ) a )->key;
+	uint64_t keyB = ( ( const TreeNode * ) b )->key;
+
+	return keyA < keyB ? -1 : keyA > keyB;
+}
+
+void removeTranspositions( void )
+{
+	int i, unique = 0;
+
+	qsort( nodes, totalNodes, sizeof( TreeNode ), compareTreeNodes );
+
+	for( i = 0; i < totalNodes; i++ )
+		if( unique == 0 || nodes[ i ].key != nodes[ unique - 1 ].key )
+			nodes[ unique++ ] = nodes[ i ];
+
+	totalNodes = unique;
+}
+
+// --- Worker process: searches positions worker, worker + workers, ... and writes one entry per position ---
+void runWorker( int worker, int workers, int outputPipe )
+{
+	if( initTranspositionTable( hashMegabytes ) < 0 )
+		exit( 1 );
+
+	for( int n = worker; n < totalNodes; n += workers )
+	{
+		BookEntry entry;
+		Move bestMove;
+
+		// every position starts from an empty table, so the book doesn't depend on the number of workers
+		clearTranspositionTable();
+		bestMove = getBestMove( &nodes[ n ].position, nodes[ n ].position.turn );
+
+		memset( &entry, 0, sizeof( entry ) );
+		entry.key = nodes[ n ].key;
+		entry.move = toCanonicalCell( &nodes[ n ].bitPosition, BIT_INDEX( bestMove.tile[ 0 ], bestMove.tile[ 1 ] ) );
+		entry.depth = searchInfo.depth;
+		entry.score = searchInfo.score > INT16_MAX ? INT16_MAX : searchInfo.score < -INT16_MAX ? -INT16_MAX : searchInfo.score;
+
+		if( write( outputPipe, &entry, sizeof( entry ) ) != sizeof( entry ) )
+			exit( 1 );
+	}
+}
+
+// --- Keep an entry sent by a worker, with progress every tenth of the book ---
+void storeEntry( void * record )
+{
+	entries[ received++ ] = *( BookEntry * ) record;
+
+	if( received % max( totalNodes / 10, 1 ) == 0 && received < totalNodes )
+	{
+		printf( "%d / %d positions\n", received, totalNodes );
+		fflush( stdout );
+	}
+}
+
+// --- Write the sorted entries, through a temporary file so that running clients never map half a book ---
+int writeBook( BookEntry * entries, int count )
+{
+	char temporary[ 1024 ];
+	BookHeader header;
+	FILE * file;
+
+	snprintf( temporary, sizeof( temporary ), "%s.tmp", bookFile );
+
+	if( ( file = fopen( temporary, "wb" ) ) == NULL )
+	{
+		printf( "Could not create %s\n", temporary );
+		return -1;
+	}
+
+	memset( &header, 0, sizeof( header ) );
+	header.magic = BOOK_MAGIC;
+	header.version = BOOK_VERSION;
+	header.count = count;
+
+	if( fwrite( &header, sizeof( header ), 1, file ) != 1 || fwrite( entries, sizeof( BookEntry ), count, file ) != ( size_t ) count )
+	{
+		printf( "Could not write %s\n", temporary );
+		fclose( file );
+		return -1;
+	}
+
+	if( fclose( file ) != 0 || rename( temporary, bookFile ) < 0 )
+	{
+		printf( "Could not write %s\n", bookFile );
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+
+// --- Main ---
+int main( int argc, char ** argv )
+{
+	int c;
+	Position start;
+	opterr = 0;
+
+	// a fixed depth and no clock, the book only depends on the options
+	searchConfig.moveTime = 0;
+	searchConfig.maxDepth = DEFAULT_BOOK_DEPTH;
+
+	while( ( c = getopt ( argc, argv, "o:p:d:j:m:w:h" ) ) != -1 )
+		switch( c )
+		{
+			case 'h':
+				printf( "[-o book_file] [-p plies] [-d depth] [-j workers] [-m hash_table_MB] [-w weights_file]\n" );
+				return 0;
+			case 'o':
+				bookFile = optarg;
+				break;
+			case 'p':
+				bookPlies = atoi( optarg );
+				break;
+			case 'd':
+				searchConfig.maxDepth = atoi( optarg );
+				if( searchConfig.maxDepth < 1 || searchConfig.maxDepth > MAX_SEARCH_DEPTH )
+				{
+					printf( "Depth must be between 1 and %d\n", MAX_SEARCH_DEPTH );
+					return 1;
+				}
+				break;
+			case 'j':
+				numberOfWorkers = atoi( optarg );
+				if( numberOfWorkers < 1 || numberOfWorkers > MAX_WORKERS )
+				{
+					printf( "Workers must be between 1 and %d\n", MAX_WORKERS );
+					return 1;
+				}
+				break;
+			case 'm':
+				hashMegabytes = atoi( optarg );
+				break;
+			case 'w':
+				weightsFile = optarg;
+				break;
+			case '?':
+				if( optopt == 'o' || optopt == 'p' || optopt == 'd' || optopt == 'j' || optopt == 'm' || optopt == 'w' )
+					printf( "Option -%c requires an argument.\n", ( char ) optopt );
+				else if( isprint( optopt ) )
+					printf( "Unknown option -%c\n", ( char ) optopt );
+				else
+					printf( "Unknown option character -%c\n", ( char ) optopt );
+				return 1;
+			default:
+			return 1;
+		}
+
+	initBoardTables();
+	initPatterns();
+	initSearch();
+
+	if( weightsFile != NULL && loadEvaluationWeights( weightsFile ) < 0 )
+		return 1;
+
+	initPosition( &start );
+	expandTree( &start, 0 );
+	removeTranspositions();
+
+	if( totalNodes == 0 )
+	{
+		printf( "No positions to search\n" );
+		return 1;
+	}
+
+	if( numberOfWorkers == 0 )
+		numberOfWorkers = onlineWorkers( 1 );
+	if( numberOfWorkers > totalNodes )
+		numberOfWorkers = totalNodes;
+
+	if( ( entries = malloc( totalNodes * sizeof( BookEntry ) ) ) == NULL )
+	{
+		printf( "ERROR: Out of memory\n" );
+		return 1;
+	}
+
+	printf( "%d positions up to ply %d, depth %d, %d workers\n", totalNodes, bookPlies, searchConfig.maxDepth, numberOfWorkers );
+	fflush( stdout );
+
+	if( runWorkers( numberOfWorkers, runWorker, sizeof( BookEntry ), storeEntry ) < 0 )
+		return 1;
+
+	if( received != totalNodes )
+	{
+		printf( "ERROR: Only %d of %d positions were searched\n", received, totalNodes );
+		return 1;
+	}
+
+	qsort( entries, received, sizeof( BookEntry ), compareBookEntries );
+
+	if( writeBook( entries, received ) < 0 )
+		return 1;
+
+	printf( "%d positions written to %s\n", received, bookFile );
+	return 0;
+}
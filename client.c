@@ -2,25 +2,15 @@
 #include "board.h"
 #include "move.h"
 #include "comm.h"
+#include "transposition.h"
+#include "pattern.h"
+#include "search.h"
+#include "book.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <ctype.h>
-#include <limits.h>
-
-// maximum depth for minimax (don't crash it!)
-#define MAX_DEPTH 5
-
-// ab-pruning flag
-#define AB_PRUNING TRUE
-
-// maximum number of moves to search
-#define MAX_MOVES_SEARCH 100
-#define TOTAL_EMPTY_CELLS 169
-
-// min(), max() macros
-#define max(a, b) ((a > b) ? a : b)
-#define min(a, b) ((a < b) ? a : b)
 
 
 /**********************************************************/
@@ -31,290 +21,114 @@ Move myMove;				// move to save our choice and send it to the server
 
 char myColor;				// to store our color
 int mySocket;				// our socket
-char msg;					// used to store the received message
+ServerMessage message;		// the received message and its payload
+
+int protocol = PROTOCOL_V1;	// what we speak with the server, v2 once we took its offer
+int offeredVersion = PROTOCOL_V1;	// highest version the server offered
 
 char * agentName = "Pápou";		//default name.. change it! keep in mind MAX_NAME_LENGTH
 
 char * ip = "127.0.0.1";	// default ip (local machine)
-/**********************************************************/
 
+char * weightsFile = NULL;	// evaluation weights (DEFAULT_WEIGHTS_FILE if it exists, otherwise built-in defaults)
 
-/* Minimax & Evaluation */
+char * bookFile = DEFAULT_BOOK_FILE;	// opening book, played from without searching while it knows the position
 
-// --- Count the Legal moves available ---
-int countAvailableMoves(Position *currentPosition, Move moves[], char color) {
-    int total_moves = 0;
+int hashMegabytes = DEFAULT_TT_MEGABYTES;	// size of the transposition table
 
-	// for each square on the board, search if its empty and legal then -> added to moves list
-	for (int i = 0; i < ARRAY_BOARD_SIZE; i++) {
-        for (int j = 0; j < ARRAY_BOARD_SIZE; j++) {
+int ponder = FALSE;			// -P: search during the opponent's time
+int ponderHitPending = FALSE;	// the opponent played the expected move, the ponder search is still going
 
-			// if square is empty and legal add the move to the list
-			if (currentPosition->board[i][j] == EMPTY) {
-				// parse the move
-				Move move = {{i, j}, color};
+#ifdef SEARCH_STATS
+FILE * statsOutput = NULL;	// -s: one JSON line per move we are asked for
+int gameNumber = 0;			// games started since the client connected
+#endif
+/**********************************************************/
 
-				if(isLegal(currentPosition, i, j, color)) {
-                    // store the move
-					moves[total_moves] = move;
+#ifdef SEARCH_STATS
+// --- Milliseconds of a clock ---
+double clockMilliseconds( clockid_t clock )
+{
+	struct timespec now;
+	clock_gettime( clock, &now );
 
-					// increase moves counter
-					total_moves++;
-                }
-            }
-        }
-    }
-	// return the total number of moves available on each game state
-    return total_moves;
+	return now.tv_sec * 1000.0 + now.tv_nsec / 1000000.0;
 }
 
+// --- Statistics go to a file (appended) or, for host:port, to a TCP socket ---
+FILE * openStatsOutput( char * target )
+{
+	char host[ 256 ];
+	char * colon = strrchr( target, ':' );
+	struct sockaddr_in address;
+	FILE * output;
+	int statsSocket;
+
+	if( colon == NULL )
+		output = fopen( target, "a" );
+	else
+	{
+		snprintf( host, sizeof( host ), "%.*s", ( int ) ( colon - target ), target );
 
-// --- Evaluation function (f) ---
-// int evaluatePosition(Position *currentPosition, char playerColor) {
-// 	// V(state) = #myDisks - #opponentDisks
-// 	int myAgentScore = currentPosition->score[(int)playerColor];
-// 	int opponentAgentScore = currentPosition->score[getOtherSide(playerColor)];
-// 	int stateValue = myAgentScore - opponentAgentScore;
-
-// 	return stateValue;
-// }
-
-
-// --- Evaluation function (f) ---
-int evaluatePosition(Position *currentPosition, char color) {
-	// we divide the game into 3 phases:
-	// Start: 0-30% of the game
-	// Middle: 30-70% of the game
-	// End: 70-100% of the game
-
-	// On each phase we adapt the weights of the evaluation function
-	// We assume that sometimes our agent has to defend or to attack (by playing more aggressive or defensive)
-
-	// F-score of state
-	int stateValue = 0;
-
-	// Enemy color
-	char enemyColor = getOtherSide(color);
-
-	// get the number of available moves for each player
-    Move moves[100];
-    int my_moves = countAvailableMoves(currentPosition, moves, color);
-    int enemy_moves = countAvailableMoves(currentPosition, moves, enemyColor);
-
-
-	// Game Progress
-    int total_discs = currentPosition->score[WHITE] + currentPosition->score[BLACK];
-    double gameProgress = (double)total_discs/TOTAL_EMPTY_CELLS;
-
-    // Disc difference #myDisks - #opponentDisks
-    int my_score = currentPosition->score[(int)color];
-    int enemy_score = currentPosition->score[(int)enemyColor];
-
-
-    int weight_factor = (gameProgress < 0.5) ? 1 : 3;
-    stateValue += weight_factor * (my_score - enemy_score);
-
-    // Mobility (More Important for White)
-	// to counter enemy
-    int mobilityWeight = (color == WHITE) ? 10 : 5;
-    stateValue += mobilityWeight * (my_moves - enemy_moves);
-
-    // corners
-    int cornerWeight = 25;
-
-	// On a 15x15 hexagonal board, there are 6 corners
-	// {0, 7} {0, 14} {7, 0} {7, 14} {14, 0} {14, 7}
-	int corners[6][2] = {{0, 7}, {0, 14}, {7, 0}, {7, 14}, {14, 0}, {14, 7}};
-
-	for (int i = 0; i < 6; i++) {
-		if (currentPosition->board[corners[i][0]][corners[i][1]] == color) {
-			stateValue += cornerWeight;
-		}
-		if (currentPosition->board[corners[i][0]][corners[i][1]] == enemyColor) {
-			stateValue -= cornerWeight;
-		}
-	}
-
-	// corners control because they are the most important, not changeable, stable
-    int stabilityScore = 0;
-	int offset = (ARRAY_BOARD_SIZE - 1) / 2;
-
-	for (int i = 0; i < ARRAY_BOARD_SIZE; i++) {
-		for (int j = 0; j < ARRAY_BOARD_SIZE; j++) {
-			if (currentPosition->board[i][j] == color) {
-				// ignore out of bound spaces
-				if (currentPosition->board[i][j] == OUT_OF_BOUND){
-					continue;
-				}
-
-				// Top-edge
-				if (i == 0 && (j >= offset && j <= ARRAY_BOARD_SIZE - offset - 1)) {
-					stabilityScore += 2;
-				}
-
-				// Bottom-edge
-				if (i == ARRAY_BOARD_SIZE - 1 && (j >= offset && j <= ARRAY_BOARD_SIZE - offset - 1)) {
-					stabilityScore += 2;
-				}
-
-				// Left-edge
-				if (j == offset - i || j == offset - (ARRAY_BOARD_SIZE - 1 - i)) {
-					stabilityScore += 2;
-				}
-
-				// Right-edge
-				if (j == offset + i || j == offset + (ARRAY_BOARD_SIZE - 1 - i)) {
-					stabilityScore += 2;
-				}
+		address.sin_family = AF_INET;
+		address.sin_port = htons( atoi( colon + 1 ) );
+		address.sin_addr.s_addr = inet_addr( host );
 
-				// Near-edge stability (adjacent to a stable edge piece)
-				if ((i > 0 && i < ARRAY_BOARD_SIZE - 1) && (j > 0 && j < ARRAY_BOARD_SIZE - 1)) {
-					// check if the piece is stable
-					// observe the geitonika boxes
-					if (currentPosition->board[i-1][j] == color && currentPosition->board[i+1][j] == color && currentPosition->board[i][j-1] == color && currentPosition->board[i][j+1] == color) {
-						stabilityScore += 1;
-					}
-				}
-			}
+		//unlike the game server, a missing collector is not waited for
+		if( ( statsSocket = socket( PF_INET, SOCK_STREAM, 0 ) ) < 0 )
+			return NULL;
+		if( connect( statsSocket, ( struct sockaddr * ) &address, sizeof( address ) ) < 0 || ( output = fdopen( statsSocket, "w" ) ) == NULL )
+		{
+			close( statsSocket );
+			return NULL;
 		}
 	}
 
+	//every line goes out whole as soon as it is written
+	if( output != NULL )
+		setvbuf( output, NULL, _IOLBF, 0 );
 
-	// black should capture corners, be more stable than white.
-    int stabilityWeight = (color == BLACK) ? 8 : 3;
-    stateValue += stabilityScore * stabilityWeight;
-
-	// me trying to outperform the enemy on the tournament
-	// STRATEGY: Make opponent apply their worst move by increasing the stability of the board
-    return stateValue;
-}
-
-
-// --- Minimax Algorithm ---
-int minimax(Position *currentPosition, int depth, int alpha, int beta, int maximizingPlayer) {
-
-	// -> Break condition
-	// -> Reached maximum depth or no more moves possible
-	if (depth == 0 || (!canMove(currentPosition, WHITE) && !canMove(currentPosition, BLACK)))
-        return evaluatePosition(currentPosition, myColor);
-
-
-	// -> Get all available moves
-    Move moves[MAX_MOVES_SEARCH];
-    int total_available_moves = countAvailableMoves(currentPosition, moves, maximizingPlayer ? myColor : getOtherSide(myColor));
-
-	// If not moves are available then, evaluate current position and return
-    if (total_available_moves == 0)
-        return evaluatePosition(currentPosition, myColor);
-
-    if (maximizingPlayer) {
-		// -> Maximize the score, starting from -infinity(or the lowest possible value)
-        int max_f_score = INT_MIN;
-
-		for (int i = 0; i < total_available_moves; i++) {
-  			// copy the current position
-			Position temporaryPosition = *currentPosition;
-
-			// make the move on the temporary position
-			doMove(&temporaryPosition, &moves[i]);
-
-			// starting minimax on that move, with the other player turn
-			int current_move_evaluation = minimax(&temporaryPosition, depth - 1, alpha, beta, FALSE);
-
-            max_f_score = max(current_move_evaluation, max_f_score);
-
-			if (AB_PRUNING) {
-				alpha = max(current_move_evaluation, alpha);
-
-				// pruning, saving time
-				if (beta <= alpha)
-					return max_f_score;
-			}
-        }
-
-        return max_f_score;
-    }
-	else {
-		// -> Minimize the score, starting from +infinity(or the highest possible value)
-        int min_f_score = INT_MAX;
-
-		for (int i = 0; i < total_available_moves; i++) {
-  			// copy the current position
-			Position temporaryPosition = *currentPosition;
-
-			// make the move on the temporary position
-			doMove(&temporaryPosition, &moves[i]);
-
-			// starting minimax on that move, with the other player turn
-            int current_move_evaluation = minimax(&temporaryPosition, depth - 1, alpha, beta, TRUE);
-
-			min_f_score = min(current_move_evaluation, min_f_score);
-
-			if (AB_PRUNING) {
-            	beta = min(current_move_evaluation, beta);
-
-				// pruning, saving time
-				if (beta <= alpha)
-					return min_f_score;
-			}
-        }
-
-        return min_f_score;
-    }
+	return output;
 }
 
+// --- One JSON line for the move we just sent: what the search did (zeros for book moves and passes) and what it cost ---
+void writeMoveStats( Move * move, char * source, SearchInfo * info, int empties, double wallStart, double cpuStart )
+{
+	long long cutoffs = 0;
+	int i;
 
+	if( statsOutput == NULL )
+		return;
 
-// --- Select Best Move ---
-Move getBestMove(Position *currentPosition, char color) {
-
-	// minimax parameters
-    int best_move_scored = INT_MIN;
-    int alpha = INT_MIN;
-    int beta = INT_MAX;
-
-
-	// get all available moves for the current player
-    Move moves[MAX_MOVES_SEARCH];
-    int total_available_moves = countAvailableMoves(currentPosition, moves, color);
-
-	// assume a perfect move
-	Move bestMove;
-
-	// if no moves are available, return a null move
-	if (total_available_moves == 0) {
-		bestMove.tile[0] = NULL_MOVE;
-		return bestMove;
-	}
+	for( i = 0; i < CUTOFF_INDEX_BINS; i++ )
+		cutoffs += info->cutoffIndex[ i ];
 
-    for (int i = 0; i < total_available_moves; i++) {
-        // copy the current position
-		Position temporaryPosition = *currentPosition;
-		doMove(&temporaryPosition, &moves[i]);
+	fprintf( statsOutput, "{\"pid\":%d,\"game\":%d,\"color\":\"%s\",\"empties\":%d,", ( int ) getpid(), gameNumber, move->color == WHITE ? "white" : "black", empties );
 
-		// start minimax using the temporary position (the move is already applied) and see if it's a good move
-		int current_move_evaluation = minimax(&temporaryPosition, MAX_DEPTH - 1, alpha, beta, FALSE);
+	if( move->tile[ 0 ] == NULL_MOVE )
+		fprintf( statsOutput, "\"move\":null," );
+	else
+		fprintf( statsOutput, "\"move\":[%d,%d],", move->tile[ 0 ], move->tile[ 1 ] );
 
-        // if a better move is found update the best move
-		if (current_move_evaluation > best_move_scored) {
-            best_move_scored = current_move_evaluation;
-            bestMove = moves[i];
-        }
+	fprintf( statsOutput, "\"source\":\"%s\",\"budgetMs\":%d,\"depth\":%d,\"score\":%d,\"nodes\":%lld,\"leafEvals\":%lld,",
+		source, searchConfig.moveTime, info->depth, info->score, info->nodes, info->leafEvaluations );
 
-		if (AB_PRUNING) {
-			// update alpha
-			alpha = max(current_move_evaluation, alpha);
+	fprintf( statsOutput, "\"ttProbes\":%lld,\"ttHits\":%lld,\"ttHitRate\":%.4f,\"ttCutoffs\":%lld,\"betaCutoffs\":%lld,\"cutoffIndex\":[",
+		info->ttProbes, info->ttHits, info->ttProbes > 0 ? ( double ) info->ttHits / info->ttProbes : 0.0, info->ttCutoffs, cutoffs );
 
-			// else prune occurs
-			if (beta <= alpha)
-				break;
-		}
-    }
+	for( i = 0; i < CUTOFF_INDEX_BINS; i++ )
+		fprintf( statsOutput, i > 0 ? ",%lld" : "%lld", info->cutoffIndex[ i ] );
 
-    return bestMove;
+	fprintf( statsOutput, "],\"searchMs\":%ld,\"wallMs\":%.1f,\"cpuMs\":%.1f}\n",
+		info->time, clockMilliseconds( CLOCK_MONOTONIC ) - wallStart, clockMilliseconds( CLOCK_PROCESS_CPUTIME_ID ) - cpuStart );
 }
 
-/**********************************************************/
+#define STATS_OPTION "s:"
+#define STATS_USAGE " [-s stats_file|host:port]"
+#else
+#define STATS_OPTION ""
+#define STATS_USAGE ""
+#endif
 
 // --- Main ---
 int main( int argc, char ** argv )
@@ -322,20 +136,66 @@ int main( int argc, char ** argv )
 	int c;
 	opterr = 0;
 
-	while( ( c = getopt ( argc, argv, "i:p:h" ) ) != -1 )
+	while( ( c = getopt ( argc, argv, "i:p:m:T:t:w:b:e:a:Ph" STATS_OPTION ) ) != -1 )
 		switch( c )
 		{
 			case 'h':
-				printf( "[-i ip] [-p port]\n" );
+				printf( "[-i ip] [-p port] [-m hash_table_MB] [-T move_time_ms] [-t threads] [-w weights_file] [-b book_file] [-e endgame_empties] [-a pvs|minimax] [-P (ponder)]" STATS_USAGE "\n" );
 				return 0;
+#ifdef SEARCH_STATS
+			case 's':
+				if( ( statsOutput = openStatsOutput( optarg ) ) == NULL )
+				{
+					printf( "Could not open stats output %s\n", optarg );
+					return 1;
+				}
+				break;
+#endif
 			case 'i':
 				ip = optarg;
 				break;
 			case 'p':
 				port = optarg;
 				break;
+			case 'm':
+				hashMegabytes = atoi( optarg );
+				break;
+			case 'T':
+				searchConfig.moveTime = atoi( optarg );
+				break;
+			case 'w':
+				weightsFile = optarg;
+				break;
+			case 'P':
+				ponder = TRUE;
+				break;
+			case 'b':
+				bookFile = optarg;
+				break;
+			case 'e':
+				searchConfig.endgameEmpties = atoi( optarg );
+				break;
+			case 'a':
+				if( strcmp( optarg, "pvs" ) == 0 )
+					searchConfig.algorithm = SEARCH_PVS;
+				else if( strcmp( optarg, "minimax" ) == 0 )
+					searchConfig.algorithm = SEARCH_MINIMAX;
+				else
+				{
+					printf( "Unknown search algorithm %s (pvs or minimax)\n", optarg );
+					return 1;
+				}
+				break;
+			case 't':
+				searchConfig.threads = atoi( optarg );
+				if( searchConfig.threads < 1 || searchConfig.threads > MAX_THREADS )
+				{
+					printf( "Threads must be between 1 and %d\n", MAX_THREADS );
+					return 1;
+				}
+				break;
 			case '?':
-				if( optopt == 'i' || optopt == 'p' )
+				if( optopt == 'i' || optopt == 'p' || optopt == 'm' || optopt == 'T' || optopt == 't' || optopt == 'w' || optopt == 'b' || optopt == 'e' || optopt == 'a' || ( optopt == 's' && STATS_OPTION[ 0 ] != '\0' ) )
 					printf( "Option -%c requires an argument.\n", ( char ) optopt );
 				else if( isprint( optopt ) )
 					printf( "Unknown option -%c\n", ( char ) optopt );
@@ -346,50 +206,153 @@ int main( int argc, char ** argv )
 			return 1;
 		}
 
+	initBoardTables();
+	initPatterns();
+	initSearch();
+
+	// weights written by ./train are picked up without -w
+	if( weightsFile == NULL && access( DEFAULT_WEIGHTS_FILE, R_OK ) == 0 )
+		weightsFile = DEFAULT_WEIGHTS_FILE;
+
+	if( weightsFile != NULL && loadEvaluationWeights( weightsFile ) < 0 )
+		return 1;
+
+	if( initTranspositionTable( hashMegabytes ) < 0 )
+		return 1;
+
+	if( openBook( bookFile ) < 0 )
+		printf( "No opening book (%s)\n", bookFile );
+
 	connectToTarget( port, ip, &mySocket );
 
+	int moveTime = searchConfig.moveTime;	// our own limit, a server clock can only lower it
+
 	while(TRUE)
 	{
-		msg = recvMsg( mySocket );
-		switch ( msg )
+		recvServerMessage( &message, protocol, mySocket );
+
+		//anything but the opponent's move and the request after it ends pondering
+		if( message.code != NM_PREPARE_TO_RECEIVE_MOVE && message.code != NM_MOVE_AND_REQUEST && message.code != NM_REQUEST_MOVE )
+		{
+			stopPondering();
+			ponderHitPending = FALSE;
+		}
+
+		//keep a tenth of the server's clock for the way back
+		searchConfig.moveTime = moveTime;
+		if( message.clock > 0 && ( moveTime == 0 || message.clock * 9 / 10 < moveTime ) )
+			searchConfig.moveTime = message.clock * 9 / 10 > 0 ? message.clock * 9 / 10 : 1;
+
+		switch ( message.code )
 		{
+			case NM_PROTOCOL_OFFER:		//server speaks a newer protocol, the name reply tells it we do too
+				offeredVersion = message.version;
+				break;
+
 			case NM_REQUEST_NAME:		//server asks for our name
-				sendName( agentName, mySocket );
+				protocol = sendNameReply( agentName, offeredVersion, mySocket );
 				break;
 
 			case NM_NEW_POSITION:		//server is trying to send us a new position
-				getPosition( &gamePosition, mySocket );
+				gamePosition = message.position;
+				clearTranspositionTable();
+				SEARCH_STAT( gameNumber++ );
 				printPosition( &gamePosition );
 				break;
 
 			case NM_COLOR_W:			//server informs us that we have WHITE color
 				myColor = WHITE;
+				clearTranspositionTable();		//stored scores are from our point of view
 				break;
 
 			case NM_COLOR_B:			//server informs us that we have BLACK color
 				myColor = BLACK;
+				clearTranspositionTable();
 				break;
 
 			case NM_PREPARE_TO_RECEIVE_MOVE:	//server informs us that he will now send us opponent's move
-				getMove( &moveReceived, mySocket );
+				moveReceived = message.move;
 				moveReceived.color = getOtherSide( myColor );
 				doMove( &gamePosition, &moveReceived );		//play opponent's move on our position
 				printPosition( &gamePosition );
+				ponderHitPending = ponderHit( &moveReceived );
 				break;
 
-			case NM_REQUEST_MOVE:		//server requests our move
-				myMove.color = myColor;
+			case NM_POSITION_DELTA:		//the server's answer to a resync
+				if( applyPositionDelta( message.delta, message.deltaLength, &gamePosition ) < 0 )
+				{
+					printf( "ERROR: Could not resync\n" );
+					return 1;
+				}
+				printPosition( &gamePosition );
+				break;
 
-				if(!canMove(&gamePosition, myColor)){
-					myMove.tile[ 0 ] = NULL_MOVE;		// we have no move ..so send null move
+			case NM_RESYNC_POSITION:	//the same answer when the whole position is shorter, the game goes on
+				gamePosition = message.position;
+				printPosition( &gamePosition );
+				break;
+
+			case NM_MOVE_AND_REQUEST:	//opponent's move and the request for ours in one message (v2)
+				moveReceived = message.move;
+				moveReceived.color = getOtherSide( myColor );
+				doMove( &gamePosition, &moveReceived );
+				printPosition( &gamePosition );
+
+				//out of sync: send ours, the server answers with what differs and asks again
+				if( positionChecksum( &gamePosition ) != message.checksum )
+				{
+					printf( "Position out of sync, resyncing\n" );
+					stopPondering();
+					sendResync( &gamePosition, mySocket );
+					break;
+				}
+				ponderHitPending = ponderHit( &moveReceived );
+				//fall through
+
+			case NM_REQUEST_MOVE:		//server requests our move
+			{
+#ifdef SEARCH_STATS
+				static SearchInfo noSearch;
+				char * source = "search";
+				SearchInfo * info = &searchInfo;
+				double wallStart = clockMilliseconds( CLOCK_MONOTONIC );
+				double cpuStart = clockMilliseconds( CLOCK_PROCESS_CPUTIME_ID );
+				int empties = PLAYABLE_CELLS - gamePosition.score[ WHITE ] - gamePosition.score[ BLACK ];
+#endif
+				if( ponderHitPending )		//we have been searching this position since the opponent started thinking
+				{
+					myMove = finishPondering();
+					ponderHitPending = FALSE;
+					printf( "Ponder hit: depth %d in %ld ms\n", searchInfo.depth, searchInfo.time );
+					SEARCH_STAT( source = "ponder" );
 				}
 				else
-					myMove = getBestMove(&gamePosition, myColor);
+				{
+					stopPondering();
 
-				sendMove( &myMove, mySocket );			//send our move
+					if( probeBook( &gamePosition, &myMove ) )
+					{
+						printf( "Book move\n" );
+						SEARCH_STAT( source = "book"; info = &noSearch );
+					}
+					else if(!canMove(&gamePosition, myColor)){
+						myMove.tile[ 0 ] = NULL_MOVE;		// we have no move ..so send null move
+						SEARCH_STAT( source = "pass"; info = &noSearch );
+					}
+					else
+						myMove = getBestMove(&gamePosition, myColor);
+				}
+				myMove.color = myColor;
+
+				sendMoveReply( &myMove, protocol, mySocket );			//send our move
+				SEARCH_STAT( writeMoveStats( &myMove, source, info, empties, wallStart, cpuStart ) );
 				doMove( &gamePosition, &myMove );		//play our move on our position
 				printPosition( &gamePosition );
+
+				if( ponder )
+					startPondering( &gamePosition, myColor );
 				break;
+			}
 
 			case NM_QUIT:			//server wants us to quit...we shall obey
 				close( mySocket );
@@ -2,10 +2,54 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
 
 /**********************************************************/
 char * port = DEFAULT_PORT;		// default port
 
+/**********************************************************/
+/* TCP may split and join segments: the blocking calls below loop until the whole message is through */
+static int sendAll( int mySocket, char * buffer, int length )
+{
+	int done = 0;
+
+	while( done < length )
+	{
+		ssize_t sent = send( mySocket, buffer + done, length - done, MSG_NOSIGNAL );
+
+		if( sent < 0 && errno == EINTR )
+			continue;
+		if( sent <= 0 )
+			return -1;
+
+		done += sent;
+	}
+
+	return length;
+}
+
+/**********************************************************/
+static int recvAll( int mySocket, char * buffer, int length )
+{
+	int done = 0;
+
+	while( done < length )
+	{
+		ssize_t received = recv( mySocket, buffer + done, length - done, 0 );
+
+		if( received < 0 && errno == EINTR )
+			continue;
+		if( received <= 0 )
+			return -1;
+
+		done += received;
+	}
+
+	return length;
+}
+
 /**********************************************************/
 void listenToSocket( char * port, int * mySocket )
 {
@@ -93,6 +137,10 @@ void connectToTarget( char * port, char * ip, int * mySocket )
 		sleep( 1 );
 	}
 
+	//every message is a complete request or reply, don't hold it back waiting for more
+	int optval = 1;
+	setsockopt( *mySocket, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval );
+
 }
 
 /**********************************************************/
@@ -102,7 +150,7 @@ int sendMsg( int msg, int mySocket )
 
 	msgCode = ( char ) msg;
 
-	if( send( mySocket, &msgCode, 1, 0 ) != 1 )
+	if( sendAll( mySocket, &msgCode, 1 ) != 1 )
 	{
 		printf( "ERROR: Network problem\n" );
 		return -1;
@@ -117,7 +165,7 @@ int recvMsg( int socket )
 {
 	char msg;
 
-	if( recv( socket, &msg, 1, 0 ) != 1 )
+	if( recvAll( socket, &msg, 1 ) != 1 )
 	{
 		printf( "ERROR: Network problem\n" );
 		exit( 1 );
@@ -136,7 +184,7 @@ int sendMove( Move * moveToSend, int mySocket )
 	buffer[ 0 ] = moveToSend->tile[ 0 ];
 	buffer[ 1 ] = moveToSend->tile[ 1 ];
 
-	if( send( mySocket, buffer, 2, 0 ) != 2 )
+	if( sendAll( mySocket, buffer, 2 ) != 2 )
 	{
 		printf( "ERROR: Network problem\n" );
 		return -1;
@@ -151,7 +199,7 @@ int getMove( Move * moveToGet, int mySocket )
 {
 	char buffer[ 2 ];
 
-	if( recv( mySocket, buffer, 2, 0 ) != 2 )
+	if( recvAll( mySocket, buffer, 2 ) != 2 )
 	{
 		printf( "ERROR: Network problem\n" );
 		return -1;
@@ -175,13 +223,13 @@ void sendName( char textToSend[ MAX_NAME_LENGTH + 1 ], int mySocket )
 	size = strlen( textToSend );
 	size_char = ( char ) size;
 
-	if( send( mySocket, &size_char, 1, 0 ) != 1 )
+	if( sendAll( mySocket, &size_char, 1 ) != 1 )
 	{
 		printf( "ERROR: Network problem\n" );
 		exit( 1 );
 	}
 
-	if( send( mySocket, textToSend, size , 0 ) != size )
+	if( sendAll( mySocket, textToSend, size ) != size )
 	{
 		printf( "ERROR: Network problem\n" );
 		exit( 1 );
@@ -198,15 +246,15 @@ int getName( char textToGet[ MAX_NAME_LENGTH + 1 ], int mySocket )
 	char size_char;
 	char dummy[256];
 
-	if( recv( mySocket, &size_char, 1, 0 ) != 1 )
+	if( recvAll( mySocket, &size_char, 1 ) != 1 )
 	{
 		printf( "ERROR: Network problem\n" );
 		return -1;
 	}
 
-	size = ( int ) size_char;
+	size = ( unsigned char ) size_char;
 
-	if( recv( mySocket, dummy, size, 0 ) != size )
+	if( recvAll( mySocket, dummy, size ) != size )
 	{
 		printf( "ERROR: Network problem\n" );
 		return -1;
@@ -223,24 +271,247 @@ int getName( char textToGet[ MAX_NAME_LENGTH + 1 ], int mySocket )
 
 
 /**********************************************************/
-int sendPosition( Position * posToSend, int mySocket )
+void packPosition( Position * posToPack, char buffer[ POSITION_BUFFER_SIZE ] )
 {
-	char buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1 ];
 	int i, j;
 
 	//board
 	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
 		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
-			buffer[ i * ARRAY_BOARD_SIZE + j ] =  posToSend->board[ i ][ j ];
+			buffer[ i * ARRAY_BOARD_SIZE + j ] =  posToPack->board[ i ][ j ];
 
 	//score
-	buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE ] = posToSend->score[ WHITE ];
-	buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 1 ] = posToSend->score[ BLACK ];
+	buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE ] = posToPack->score[ WHITE ];
+	buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 1 ] = posToPack->score[ BLACK ];
 
 	//turn
-	buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 ] = posToSend->turn;
+	buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 ] = posToPack->turn;
+}
+
+/**********************************************************/
+void unpackPosition( char buffer[ POSITION_BUFFER_SIZE ], Position * posToUnpack )
+{
+	int i, j;
+
+	//board
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			posToUnpack->board[ i ][ j ] = buffer[ i * ARRAY_BOARD_SIZE + j ];
+
+	//score (up to BOARD_CELLS, past what a signed char holds)
+	posToUnpack->score[ WHITE ] = ( unsigned char ) buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE ];
+	posToUnpack->score[ BLACK ] = ( unsigned char ) buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 1 ];
+
+	//turn
+	posToUnpack->turn = buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 ];
+}
+
+/**********************************************************/
+static unsigned int readWord( char * buffer )
+{
+	return ( ( unsigned char ) buffer[ 0 ] << 24 ) | ( ( unsigned char ) buffer[ 1 ] << 16 ) | ( ( unsigned char ) buffer[ 2 ] << 8 ) | ( unsigned char ) buffer[ 3 ];
+}
+
+/**********************************************************/
+static void writeWord( char * buffer, unsigned int word )
+{
+	buffer[ 0 ] = ( char ) ( word >> 24 );
+	buffer[ 1 ] = ( char ) ( word >> 16 );
+	buffer[ 2 ] = ( char ) ( word >> 8 );
+	buffer[ 3 ] = ( char ) word;
+}
+
+/**********************************************************/
+/* writes a v2 header in front of length bytes of payload, returns the frame size */
+static int writeHeader( char * buffer, int code, int length )
+{
+	buffer[ 0 ] = ( char ) ( ( length + 1 ) >> 8 );
+	buffer[ 1 ] = ( char ) ( length + 1 );
+	buffer[ 2 ] = ( char ) code;
+
+	return V2_HEADER_SIZE + length;
+}
+
+/**********************************************************/
+/* Compact positions: cell n of the hexagon is at cellRow[ n ], cellCol[ n ] */
+static int cellRow[ BOARD_CELLS ], cellCol[ BOARD_CELLS ];
+static int cellsReady = FALSE;
+
+static void initCells( void )
+{
+	Position pos;
+	int i, j, n = 0;
+
+	initPosition( &pos );
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+			if( pos.board[ i ][ j ] != OUT_OF_BOUND )
+			{
+				cellRow[ n ] = i;
+				cellCol[ n ] = j;
+				n++;
+			}
+
+	cellsReady = TRUE;
+}
+
+/**********************************************************/
+/* board and turn of the compact format, returns their size (what the checksum covers) */
+static int packCells( Position * pos, char * buffer )
+{
+	int n, size = ( BOARD_CELLS * 2 + 7 ) / 8;
+
+	if( !cellsReady )
+		initCells();
+
+	memset( buffer, 0, size );
+	for( n = 0; n < BOARD_CELLS; n++ )
+		buffer[ n / 4 ] |= ( pos->board[ cellRow[ n ] ][ cellCol[ n ] ] & 3 ) << ( ( n % 4 ) * 2 );
+
+	buffer[ size ] = pos->turn;
+
+	return size + 1;
+}
+
+/**********************************************************/
+static unsigned int checksumBytes( char * buffer, int length )
+{
+	unsigned int hash = 2166136261u;
+	int i;
 
-	if( send( mySocket, buffer, ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1, 0 ) != ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1 )
+	for( i = 0; i < length; i++ )
+	{
+		hash ^= ( unsigned char ) buffer[ i ];
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
+/**********************************************************/
+static void countScores( Position * pos )
+{
+	int n;
+
+	pos->score[ WHITE ] = 0;
+	pos->score[ BLACK ] = 0;
+
+	for( n = 0; n < BOARD_CELLS; n++ )
+		if( pos->board[ cellRow[ n ] ][ cellCol[ n ] ] == WHITE || pos->board[ cellRow[ n ] ][ cellCol[ n ] ] == BLACK )
+			pos->score[ ( int ) pos->board[ cellRow[ n ] ][ cellCol[ n ] ] ]++;
+}
+
+/**********************************************************/
+unsigned int positionChecksum( Position * pos )
+{
+	char buffer[ COMPACT_POSITION_SIZE ];
+
+	return checksumBytes( buffer, packCells( pos, buffer ) );
+}
+
+/**********************************************************/
+void packCompactPosition( Position * posToPack, char buffer[ COMPACT_POSITION_SIZE ] )
+{
+	int size = packCells( posToPack, buffer );
+
+	writeWord( buffer + size, checksumBytes( buffer, size ) );
+}
+
+/**********************************************************/
+int unpackCompactPosition( char buffer[ COMPACT_POSITION_SIZE ], Position * posToUnpack )
+{
+	Position pos;
+	int n, size = ( BOARD_CELLS * 2 + 7 ) / 8;
+
+	if( checksumBytes( buffer, size + 1 ) != readWord( buffer + size + 1 ) )
+		return -1;
+
+	//OUT_OF_BOUND cells are not sent
+	initPosition( &pos );
+	if( !cellsReady )
+		initCells();
+
+	for( n = 0; n < BOARD_CELLS; n++ )
+		pos.board[ cellRow[ n ] ][ cellCol[ n ] ] = ( buffer[ n / 4 ] >> ( ( n % 4 ) * 2 ) ) & 3;
+
+	pos.turn = buffer[ size ];
+	countScores( &pos );
+
+	*posToUnpack = pos;
+	return 0;
+}
+
+/**********************************************************/
+int packPositionDelta( Position * from, Position * to, char buffer[ MAX_DELTA_SIZE ] )
+{
+	int n, count = 0;
+
+	if( !cellsReady )
+		initCells();
+
+	for( n = 0; n < BOARD_CELLS; n++ )
+		if( from->board[ cellRow[ n ] ][ cellCol[ n ] ] != to->board[ cellRow[ n ] ][ cellCol[ n ] ] )
+		{
+			//count, pairs, turn, checksum
+			if( 1 + 2 * ( count + 1 ) + 1 + CHECKSUM_SIZE > MAX_DELTA_SIZE )
+				return -1;
+
+			buffer[ 1 + 2 * count ] = ( char ) n;
+			buffer[ 1 + 2 * count + 1 ] = to->board[ cellRow[ n ] ][ cellCol[ n ] ];
+			count++;
+		}
+
+	buffer[ 0 ] = ( char ) count;
+	buffer[ 1 + 2 * count ] = to->turn;
+	writeWord( buffer + 1 + 2 * count + 1, positionChecksum( to ) );
+
+	return 1 + 2 * count + 1 + CHECKSUM_SIZE;
+}
+
+/**********************************************************/
+int applyPositionDelta( char * buffer, int length, Position * pos )
+{
+	Position result = *pos;
+	int k, n, count;
+
+	if( length < 1 + 1 + CHECKSUM_SIZE )
+		return -1;
+
+	count = ( unsigned char ) buffer[ 0 ];
+	if( length != 1 + 2 * count + 1 + CHECKSUM_SIZE )
+		return -1;
+
+	if( !cellsReady )
+		initCells();
+
+	for( k = 0; k < count; k++ )
+	{
+		n = ( unsigned char ) buffer[ 1 + 2 * k ];
+		if( n >= BOARD_CELLS || ( unsigned char ) buffer[ 1 + 2 * k + 1 ] > ILLEGAL )
+			return -1;
+
+		result.board[ cellRow[ n ] ][ cellCol[ n ] ] = buffer[ 1 + 2 * k + 1 ];
+	}
+
+	result.turn = buffer[ 1 + 2 * count ];
+	countScores( &result );
+
+	if( positionChecksum( &result ) != readWord( buffer + 1 + 2 * count + 1 ) )
+		return -1;
+
+	*pos = result;
+	return 0;
+}
+
+/**********************************************************/
+int sendPosition( Position * posToSend, int mySocket )
+{
+	char buffer[ POSITION_BUFFER_SIZE ];
+
+	packPosition( posToSend, buffer );
+
+	if( sendAll( mySocket, buffer, POSITION_BUFFER_SIZE ) != POSITION_BUFFER_SIZE )
 	{
 		printf( "ERROR: Network problem\n" );
 		return -1;
@@ -253,24 +524,597 @@ int sendPosition( Position * posToSend, int mySocket )
 /**********************************************************/
 void getPosition( Position * posToGet, int mySocket )
 {
-	char buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1 ];
-	int i, j;
+	char buffer[ POSITION_BUFFER_SIZE ];
 
-	if( recv( mySocket, buffer, ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1, 0 ) != ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1 )
+	if( recvAll( mySocket, buffer, POSITION_BUFFER_SIZE ) != POSITION_BUFFER_SIZE )
 	{
 		printf( "ERROR: Network problem\n" );
 		exit( 1 );
 	}
 
-	//board
-	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
-		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
-			posToGet->board[ i ][ j ] = buffer[ i * ARRAY_BOARD_SIZE + j ];
+	unpackPosition( buffer, posToGet );
+}
 
-	//score
-	posToGet->score[ WHITE ] = buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE ];
-	posToGet->score[ BLACK ] = buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 1 ];
 
-	//turn
-	posToGet->turn = buffer[ ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 ];
+/**********************************************************/
+int recvServerMessage( ServerMessage * message, int protocol, int mySocket )
+{
+	char buffer[ V2_HEADER_SIZE + POSITION_BUFFER_SIZE ];
+	char * payload;
+	int length;
+
+	message->clock = 0;
+
+	if( protocol == PROTOCOL_V1 )
+	{
+		message->code = recvMsg( mySocket );
+
+		if( message->code == NM_NEW_POSITION )
+			getPosition( &message->position, mySocket );
+		else if( message->code == NM_PREPARE_TO_RECEIVE_MOVE )
+			getMove( &message->move, mySocket );
+		else if( message->code == NM_PROTOCOL_OFFER )
+			message->version = recvMsg( mySocket );
+
+		return message->code;
+	}
+
+	if( recvAll( mySocket, buffer, 2 ) != 2 )
+	{
+		printf( "ERROR: Network problem\n" );
+		exit( 1 );
+	}
+
+	length = ( ( unsigned char ) buffer[ 0 ] << 8 ) | ( unsigned char ) buffer[ 1 ];
+	if( length < 1 || length > ( int ) sizeof( buffer ) - 2 || recvAll( mySocket, buffer + 2, length ) != length )
+	{
+		printf( "ERROR: Network problem\n" );
+		exit( 1 );
+	}
+
+	message->code = ( unsigned char ) buffer[ 2 ];
+	payload = buffer + V2_HEADER_SIZE;
+	length--;
+
+	//a payload that doesn't fit its code is as bad as a lost connection
+	if( ( ( message->code == NM_NEW_POSITION || message->code == NM_RESYNC_POSITION ) && length != COMPACT_POSITION_SIZE ) || ( message->code == NM_PREPARE_TO_RECEIVE_MOVE && length != 2 )
+		|| ( message->code == NM_REQUEST_MOVE && length != CLOCK_SIZE ) || ( message->code == NM_MOVE_AND_REQUEST && length != 2 + CLOCK_SIZE + CHECKSUM_SIZE )
+		|| ( message->code == NM_POSITION_DELTA && length > MAX_DELTA_SIZE ) )
+	{
+		printf( "ERROR: Network problem\n" );
+		exit( 1 );
+	}
+
+	switch( message->code )
+	{
+		case NM_NEW_POSITION:
+		case NM_RESYNC_POSITION:
+			if( unpackCompactPosition( payload, &message->position ) < 0 )
+			{
+				printf( "ERROR: Position checksum mismatch\n" );
+				exit( 1 );
+			}
+			break;
+		case NM_POSITION_DELTA:
+			memcpy( message->delta, payload, length );
+			message->deltaLength = length;
+			break;
+		case NM_PREPARE_TO_RECEIVE_MOVE:
+			message->move.tile[ 0 ] = payload[ 0 ];
+			message->move.tile[ 1 ] = payload[ 1 ];
+			break;
+		case NM_REQUEST_MOVE:
+			message->clock = readWord( payload );
+			break;
+		case NM_MOVE_AND_REQUEST:
+			message->move.tile[ 0 ] = payload[ 0 ];
+			message->move.tile[ 1 ] = payload[ 1 ];
+			message->clock = readWord( payload + 2 );
+			message->checksum = readWord( payload + 2 + CLOCK_SIZE );
+			break;
+	}
+
+	return message->code;
+}
+
+/**********************************************************/
+int sendMoveReply( Move * moveToSend, int protocol, int mySocket )
+{
+	char buffer[ V2_HEADER_SIZE + 2 ];
+
+	if( protocol == PROTOCOL_V1 )
+		return sendMove( moveToSend, mySocket );
+
+	buffer[ V2_HEADER_SIZE ] = moveToSend->tile[ 0 ];
+	buffer[ V2_HEADER_SIZE + 1 ] = moveToSend->tile[ 1 ];
+
+	if( sendAll( mySocket, buffer, writeHeader( buffer, NM_REQUEST_MOVE, 2 ) ) < 0 )
+	{
+		printf( "ERROR: Network problem\n" );
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+int sendResync( Position * myPosition, int mySocket )
+{
+	char buffer[ V2_HEADER_SIZE + COMPACT_POSITION_SIZE ];
+
+	packCompactPosition( myPosition, buffer + V2_HEADER_SIZE );
+
+	if( sendAll( mySocket, buffer, writeHeader( buffer, NM_RESYNC, COMPACT_POSITION_SIZE ) ) < 0 )
+	{
+		printf( "ERROR: Network problem\n" );
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+int sendNameReply( char textToSend[ MAX_NAME_LENGTH + 1 ], int offeredVersion, int mySocket )
+{
+	char buffer[ 1 + V2_HEADER_SIZE + 1 + MAX_NAME_LENGTH ];
+	int size = strlen( textToSend );
+
+	if( offeredVersion < PROTOCOL_V2 )
+	{
+		sendName( textToSend, mySocket );
+		return PROTOCOL_V1;
+	}
+
+	if( size > MAX_NAME_LENGTH )
+		size = MAX_NAME_LENGTH;
+
+	//accept and name leave together
+	buffer[ 0 ] = ( char ) ( PROTOCOL_ACCEPT | PROTOCOL_V2 );
+	buffer[ 1 + V2_HEADER_SIZE ] = ( char ) size;
+	memcpy( buffer + 1 + V2_HEADER_SIZE + 1, textToSend, size );
+
+	if( sendAll( mySocket, buffer, 1 + writeHeader( buffer + 1, NM_REQUEST_NAME, 1 + size ) ) < 0 )
+	{
+		printf( "ERROR: Network problem\n" );
+		exit( 1 );
+	}
+
+	return PROTOCOL_V2;
+}
+
+
+/**********************************************************/
+/* Non-blocking connections and the epoll reactor */
+/**********************************************************/
+static void setNonBlocking( int mySocket )
+{
+	fcntl( mySocket, F_SETFL, fcntl( mySocket, F_GETFL, 0 ) | O_NONBLOCK );
+}
+
+/**********************************************************/
+static void watchConnection( Connection * conn, int op )
+{
+	struct epoll_event event;
+
+	event.events = EPOLLIN | ( conn->outputLength > 0 ? EPOLLOUT : 0 );
+	event.data.ptr = conn;
+	epoll_ctl( conn->reactor->epollFd, op, conn->socket, &event );
+}
+
+/**********************************************************/
+int initReactor( Reactor * reactor )
+{
+	if( ( reactor->epollFd = epoll_create1( 0 ) ) < 0 )
+	{
+		printf( "ERROR: epoll_create failed\n" );
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+/* listeners are told apart from connections by a tagged pointer: no Connection lives at an odd address */
+int reactorAddListener( Reactor * reactor, int listenSocket, void * owner )
+{
+	struct epoll_event event;
+
+	setNonBlocking( listenSocket );
+
+	event.events = EPOLLIN;
+	event.data.ptr = ( char * ) owner + 1;
+	return epoll_ctl( reactor->epollFd, EPOLL_CTL_ADD, listenSocket, &event );
+}
+
+/**********************************************************/
+int reactorAddConnection( Reactor * reactor, Connection * conn )
+{
+	conn->reactor = reactor;
+	watchConnection( conn, EPOLL_CTL_ADD );
+
+	return 0;
+}
+
+/**********************************************************/
+int reactorWait( Reactor * reactor, ReactorEvent events[ MAX_REACTOR_EVENTS ], int timeout )
+{
+	struct epoll_event ready[ MAX_REACTOR_EVENTS ];
+	int i, n;
+
+	if( ( n = epoll_wait( reactor->epollFd, ready, MAX_REACTOR_EVENTS, timeout ) ) < 0 )
+		return 0;
+
+	for( i = 0; i < n; i++ )
+	{
+		if( ( ( uintptr_t ) ready[ i ].data.ptr ) & 1 )
+		{
+			events[ i ].owner = ( char * ) ready[ i ].data.ptr - 1;
+			events[ i ].readable = TRUE;
+			events[ i ].writable = FALSE;
+			continue;
+		}
+
+		events[ i ].owner = ( ( Connection * ) ready[ i ].data.ptr )->owner;
+		events[ i ].readable = ( ready[ i ].events & ( EPOLLIN | EPOLLHUP | EPOLLERR ) ) != 0;
+		events[ i ].writable = ( ready[ i ].events & EPOLLOUT ) != 0;
+	}
+
+	return n;
+}
+
+/**********************************************************/
+void initConnection( Connection * conn, int socket, void * owner )
+{
+	int optval = 1;
+
+	setNonBlocking( socket );
+	setsockopt( socket, IPPROTO_TCP, TCP_NODELAY, &optval, sizeof optval );
+
+	conn->socket = socket;
+	conn->reactor = NULL;
+	conn->owner = owner;
+	conn->protocol = PROTOCOL_V1;
+	conn->inputLength = 0;
+	conn->outputLength = 0;
+}
+
+/**********************************************************/
+void closeConnection( Connection * conn )
+{
+	if( conn->socket < 0 )
+		return;
+
+	if( conn->reactor != NULL )
+		epoll_ctl( conn->reactor->epollFd, EPOLL_CTL_DEL, conn->socket, NULL );
+
+	close( conn->socket );
+	conn->socket = -1;
+	conn->inputLength = 0;
+	conn->outputLength = 0;
+}
+
+/**********************************************************/
+int connectionRead( Connection * conn )
+{
+	while( conn->socket >= 0 )
+	{
+		ssize_t received;
+
+		if( conn->inputLength == CONNECTION_BUFFER_SIZE )
+			return -1;
+
+		received = recv( conn->socket, conn->input + conn->inputLength, CONNECTION_BUFFER_SIZE - conn->inputLength, 0 );
+
+		if( received > 0 )
+		{
+			conn->inputLength += received;
+			continue;
+		}
+
+		if( received < 0 && errno == EINTR )
+			continue;
+		if( received < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+			return 0;
+
+		return -1;		//closed by the peer, or failed
+	}
+
+	return -1;
+}
+
+/**********************************************************/
+int connectionFlush( Connection * conn )
+{
+	int had_output = conn->outputLength > 0;
+	int done = 0;
+
+	if( conn->socket < 0 )
+		return -1;
+
+	while( done < conn->outputLength )
+	{
+		ssize_t sent = send( conn->socket, conn->output + done, conn->outputLength - done, MSG_NOSIGNAL );
+
+		if( sent > 0 )
+		{
+			done += sent;
+			continue;
+		}
+
+		if( sent < 0 && errno == EINTR )
+			continue;
+		if( sent < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+			break;
+
+		return -1;
+	}
+
+	memmove( conn->output, conn->output + done, conn->outputLength - done );
+	conn->outputLength -= done;
+
+	//output interest only while something waits, otherwise epoll would report every idle socket
+	if( conn->reactor != NULL && had_output != ( conn->outputLength > 0 ) )
+		watchConnection( conn, EPOLL_CTL_MOD );
+
+	return 0;
+}
+
+/**********************************************************/
+int connectionFrame( Connection * conn, int frameType )
+{
+	int length;
+
+	if( conn->inputLength == 0 )
+		return 0;
+
+	//the client took the offer: the accept byte goes, v2 starts with the name behind it
+	if( conn->protocol == PROTOCOL_V1 && frameType == FRAME_NAME && ( conn->input[ 0 ] & PROTOCOL_ACCEPT ) )
+	{
+		conn->protocol = PROTOCOL_V2;
+		connectionConsume( conn, 1 );
+		return connectionFrame( conn, frameType );
+	}
+
+	if( conn->protocol == PROTOCOL_V2 )
+	{
+		if( conn->inputLength < 2 )
+			return 0;
+		length = 2 + ( ( ( unsigned char ) conn->input[ 0 ] << 8 ) | ( unsigned char ) conn->input[ 1 ] );
+		return conn->inputLength >= length ? length : 0;
+	}
+
+	switch( frameType )
+	{
+		case FRAME_NAME:
+			length = 1 + ( unsigned char ) conn->input[ 0 ];
+			break;
+		case FRAME_MOVE:
+			length = 2;
+			break;
+		default:
+			if( conn->input[ 0 ] == NM_NEW_POSITION )
+				length = 1 + POSITION_BUFFER_SIZE;
+			else if( conn->input[ 0 ] == NM_PREPARE_TO_RECEIVE_MOVE )
+				length = 1 + 2;
+			else if( conn->input[ 0 ] == NM_PROTOCOL_OFFER )
+				length = 1 + 1;
+			else
+				length = 1;
+	}
+
+	return conn->inputLength >= length ? length : 0;
+}
+
+/**********************************************************/
+char * connectionPayload( Connection * conn )
+{
+	return conn->protocol == PROTOCOL_V2 ? conn->input + V2_HEADER_SIZE : conn->input;
+}
+
+/**********************************************************/
+int frameCode( Connection * conn )
+{
+	return conn->protocol == PROTOCOL_V2 ? ( unsigned char ) conn->input[ 2 ] : 0;
+}
+
+/**********************************************************/
+int frameFits( Connection * conn, int frameType, int length )
+{
+	char * payload = conn->input + V2_HEADER_SIZE;
+
+	//v1 frames are as long as their type says
+	if( conn->protocol != PROTOCOL_V2 )
+		return TRUE;
+
+	//the code counts in the length, a frame without one is as bad as one with the wrong payload
+	if( length < V2_HEADER_SIZE )
+		return FALSE;
+	length -= V2_HEADER_SIZE;
+
+	switch( frameType )
+	{
+		case FRAME_NAME:
+			return frameCode( conn ) == NM_REQUEST_NAME && length >= 1 && length == 1 + ( unsigned char ) payload[ 0 ];
+		case FRAME_MOVE:
+			return ( frameCode( conn ) == NM_REQUEST_MOVE && length == 2 ) || ( frameCode( conn ) == NM_RESYNC && length == COMPACT_POSITION_SIZE );
+	}
+
+	return FALSE;
+}
+
+/**********************************************************/
+void connectionConsume( Connection * conn, int length )
+{
+	memmove( conn->input, conn->input + length, conn->inputLength - length );
+	conn->inputLength -= length;
+}
+
+/**********************************************************/
+int queueBytes( Connection * conn, char * bytes, int length )
+{
+	if( conn->socket < 0 || conn->outputLength + length > CONNECTION_BUFFER_SIZE )
+		return -1;
+
+	//output interest from now on, the event loop flushes
+	if( conn->outputLength == 0 && conn->reactor != NULL )
+	{
+		conn->outputLength = length;
+		watchConnection( conn, EPOLL_CTL_MOD );
+		conn->outputLength = 0;
+	}
+
+	memcpy( conn->output + conn->outputLength, bytes, length );
+	conn->outputLength += length;
+
+	return 0;
+}
+
+/**********************************************************/
+/* queues a message: the bare v1 bytes, or a v2 frame around the payload */
+static int queueMessage( Connection * conn, int code, char * payload, int length )
+{
+	char buffer[ V2_HEADER_SIZE + POSITION_BUFFER_SIZE ];
+
+	if( conn->protocol == PROTOCOL_V2 )
+	{
+		memcpy( buffer + V2_HEADER_SIZE, payload, length );
+		return queueBytes( conn, buffer, writeHeader( buffer, code, length ) );
+	}
+
+	return queueBytes( conn, payload, length );
+}
+
+/**********************************************************/
+int queueMsg( Connection * conn, int msg )
+{
+	char msgCode = ( char ) msg;
+
+	if( conn->protocol == PROTOCOL_V2 )
+		return queueMessage( conn, msg, NULL, 0 );
+
+	return queueBytes( conn, &msgCode, 1 );
+}
+
+/**********************************************************/
+int queueMove( Connection * conn, Move * moveToSend )
+{
+	char buffer[ 3 ];
+
+	buffer[ 0 ] = NM_PREPARE_TO_RECEIVE_MOVE;
+	buffer[ 1 ] = moveToSend->tile[ 0 ];
+	buffer[ 2 ] = moveToSend->tile[ 1 ];
+
+	//the v2 header carries the code
+	if( conn->protocol == PROTOCOL_V2 )
+		return queueMessage( conn, NM_PREPARE_TO_RECEIVE_MOVE, buffer + 1, 2 );
+
+	return queueBytes( conn, buffer, 3 );
+}
+
+/**********************************************************/
+int queuePosition( Connection * conn, Position * posToSend )
+{
+	char buffer[ 1 + POSITION_BUFFER_SIZE ];
+
+	//v2 sends the compact format
+	if( conn->protocol == PROTOCOL_V2 )
+	{
+		packCompactPosition( posToSend, buffer );
+		return queueMessage( conn, NM_NEW_POSITION, buffer, COMPACT_POSITION_SIZE );
+	}
+
+	buffer[ 0 ] = NM_NEW_POSITION;
+	packPosition( posToSend, buffer + 1 );
+
+	return queueBytes( conn, buffer, 1 + POSITION_BUFFER_SIZE );
+}
+
+/**********************************************************/
+int queueName( Connection * conn, char textToSend[ MAX_NAME_LENGTH + 1 ] )
+{
+	char buffer[ 1 + MAX_NAME_LENGTH ];
+	int size = strlen( textToSend );
+
+	if( size > MAX_NAME_LENGTH )
+		size = MAX_NAME_LENGTH;
+
+	buffer[ 0 ] = ( char ) size;
+	memcpy( buffer + 1, textToSend, size );
+
+	return queueMessage( conn, NM_REQUEST_NAME, buffer, 1 + size );
+}
+
+/**********************************************************/
+int queueOffer( Connection * conn )
+{
+	char buffer[ 2 ];
+
+	buffer[ 0 ] = NM_PROTOCOL_OFFER;
+	buffer[ 1 ] = PROTOCOL_V2;
+
+	return queueBytes( conn, buffer, 2 );
+}
+
+/**********************************************************/
+int queueMoveRequest( Connection * conn, Move * opponentMove, Position * pos, int clock )
+{
+	char buffer[ V2_HEADER_SIZE + 2 + CLOCK_SIZE + CHECKSUM_SIZE ];
+
+	if( conn->protocol == PROTOCOL_V2 )
+	{
+		if( opponentMove == NULL )
+		{
+			writeWord( buffer + V2_HEADER_SIZE, clock );
+			return queueBytes( conn, buffer, writeHeader( buffer, NM_REQUEST_MOVE, CLOCK_SIZE ) );
+		}
+
+		buffer[ V2_HEADER_SIZE ] = opponentMove->tile[ 0 ];
+		buffer[ V2_HEADER_SIZE + 1 ] = opponentMove->tile[ 1 ];
+		writeWord( buffer + V2_HEADER_SIZE + 2, clock );
+		writeWord( buffer + V2_HEADER_SIZE + 2 + CLOCK_SIZE, positionChecksum( pos ) );
+		return queueBytes( conn, buffer, writeHeader( buffer, NM_MOVE_AND_REQUEST, 2 + CLOCK_SIZE + CHECKSUM_SIZE ) );
+	}
+
+	if( opponentMove == NULL )
+		return queueMsg( conn, NM_REQUEST_MOVE );
+
+	buffer[ 0 ] = NM_PREPARE_TO_RECEIVE_MOVE;
+	buffer[ 1 ] = opponentMove->tile[ 0 ];
+	buffer[ 2 ] = opponentMove->tile[ 1 ];
+	buffer[ 3 ] = NM_REQUEST_MOVE;
+	return queueBytes( conn, buffer, 4 );
+}
+
+/**********************************************************/
+int queueResync( Connection * conn, char * clientPosition, Position * pos )
+{
+	char buffer[ COMPACT_POSITION_SIZE ];
+	Position client;
+	int length;
+
+	if( unpackCompactPosition( clientPosition, &client ) == 0 && ( length = packPositionDelta( &client, pos, buffer ) ) > 0 )
+		return queueMessage( conn, NM_POSITION_DELTA, buffer, length );
+
+	//not NM_NEW_POSITION: the game goes on, the client keeps what it knows about it
+	packCompactPosition( pos, buffer );
+	return queueMessage( conn, NM_RESYNC_POSITION, buffer, COMPACT_POSITION_SIZE );
+}
+
+/**********************************************************/
+void frameToMove( char * frame, Move * moveToGet )
+{
+	moveToGet->tile[ 0 ] = frame[ 0 ];
+	moveToGet->tile[ 1 ] = frame[ 1 ];
+}
+
+/**********************************************************/
+void frameToName( char * frame, char textToGet[ MAX_NAME_LENGTH + 1 ] )
+{
+	int size = ( unsigned char ) frame[ 0 ];
+
+	if( size > MAX_NAME_LENGTH )
+		size = MAX_NAME_LENGTH;
+
+	memcpy( textToGet, frame + 1, size );
+	textToGet[ size ] = '\0';
 }
@@ -9,9 +9,13 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 
 /**********************************************************/
 #define MAXPENDING 10
+
+// a position on the wire: the board, both scores and the turn, one char each
+#define POSITION_BUFFER_SIZE ( ARRAY_BOARD_SIZE * ARRAY_BOARD_SIZE + 2 + 1 )
 /**********************************************************/
 #define NM_NEW_POSITION 101
 #define NM_COLOR_W 102
@@ -20,6 +24,83 @@
 #define NM_PREPARE_TO_RECEIVE_MOVE 105
 #define NM_REQUEST_NAME 106
 #define NM_QUIT 107
+#define NM_PROTOCOL_OFFER 108			//+ 1 byte: highest protocol version the server speaks (clients that don't know it ignore it)
+#define NM_MOVE_AND_REQUEST 109			//v2 only: the opponent's move and a move request with its clock in one message
+#define NM_POSITION_DELTA 110			//v2 only: the cells that differ from what the client reported, answers NM_RESYNC
+#define NM_RESYNC 111					//v2 only, client -> server: instead of a move, our position no longer matches the checksum
+#define NM_RESYNC_POSITION 112			//v2 only: the whole compact position, answers NM_RESYNC when a delta would not be shorter (same game)
+/**********************************************************/
+/* Protocol versions. v1 is the one-byte NM_* stream above. The server offers v2 with
+NM_PROTOCOL_OFFER just before NM_REQUEST_NAME, a client that speaks it answers with
+PROTOCOL_ACCEPT | version (never a name length) in front of its name, then everything
+in both directions is a v2 frame: 2 bytes big endian length of what follows, the NM_*
+code (replies carry the code of the request), the payload. */
+#define PROTOCOL_V1 1
+#define PROTOCOL_V2 2
+#define PROTOCOL_ACCEPT 0x80
+#define V2_HEADER_SIZE 3
+#define CLOCK_SIZE 4					//ms for the move, big endian, 0 when there is no limit
+#define CHECKSUM_SIZE 4					//positionChecksum(), big endian
+
+/* Compact positions (v2). The cells of the hexagon in row order at 2 bits each (their
+WHITE/BLACK/EMPTY/ILLEGAL value), then the turn and the checksum. Scores are counted
+on arrival. A delta is a count, that many (cell number, value) pairs, the turn and
+the checksum of the result, and it is only used while it is smaller. */
+#define BOARD_CELLS ( 3 * HEX_BOARD_RADIUS * ( HEX_BOARD_RADIUS + 1 ) + 1 )
+#define COMPACT_POSITION_SIZE ( ( BOARD_CELLS * 2 + 7 ) / 8 + 1 + CHECKSUM_SIZE )
+#define MAX_DELTA_SIZE ( COMPACT_POSITION_SIZE - 1 )
+
+/* A server message with its payload decoded, whatever the protocol (used by client) */
+typedef struct
+{
+	int code;							//NM_*
+	Move move;							//NM_PREPARE_TO_RECEIVE_MOVE, NM_MOVE_AND_REQUEST
+	Position position;					//NM_NEW_POSITION, NM_RESYNC_POSITION
+	int clock;							//NM_REQUEST_MOVE, NM_MOVE_AND_REQUEST (v2 only, 0 otherwise)
+	unsigned int checksum;				//NM_MOVE_AND_REQUEST: of the position after the move
+	char delta[ MAX_DELTA_SIZE ];		//NM_POSITION_DELTA, for applyPositionDelta()
+	int deltaLength;
+	int version;						//NM_PROTOCOL_OFFER
+} ServerMessage;
+/**********************************************************/
+/* Non-blocking connections (used by servers that multiplex many clients) */
+#define CONNECTION_BUFFER_SIZE 4096
+
+// what the next bytes of a connection's input are
+#define FRAME_NAME 1				//a name: length byte + name (client -> server)
+#define FRAME_MOVE 2				//a move: two bytes (client -> server)
+#define FRAME_MESSAGE 3				//an NM_* code and its payload (server -> client)
+
+#define MAX_REACTOR_EVENTS 64
+/**********************************************************/
+typedef struct Reactor Reactor;
+
+/* One socket with its own buffers, a stalled peer only fills its own output buffer */
+typedef struct
+{
+	int socket;									//-1 once closed
+	Reactor * reactor;							//the reactor watching it (or NULL)
+	void * owner;								//returned with every event of this connection
+	int protocol;								//PROTOCOL_V1 until the peer accepts an offer
+
+	char input[ CONNECTION_BUFFER_SIZE ];		//received, not yet consumed
+	int inputLength;
+	char output[ CONNECTION_BUFFER_SIZE ];		//queued, not yet accepted by the socket
+	int outputLength;
+} Connection;
+
+/* epoll set of connections (and listening sockets) */
+struct Reactor
+{
+	int epollFd;								//readable whenever an event is pending, so another main loop (gtk) can watch it and call reactorWait() with timeout 0
+};
+
+typedef struct
+{
+	void * owner;								//owner of the connection, or the pointer given to reactorAddListener()
+	int readable;
+	int writable;
+} ReactorEvent;
 /**********************************************************/
 extern char * port;
 /**********************************************************/
@@ -51,10 +132,108 @@ void sendName( char textToSend[ MAX_NAME_LENGTH + 1 ], int mySocket );
 int getName( char textToGet[ MAX_NAME_LENGTH + 1 ], int mySocket );
 //used to receive agent's name
 
+void packPosition( Position * posToPack, char buffer[ POSITION_BUFFER_SIZE ] );
+//writes a position in its wire format (also used for position files)
+
+void unpackPosition( char buffer[ POSITION_BUFFER_SIZE ], Position * posToUnpack );
+//reads a position back from its wire format
+
+unsigned int positionChecksum( Position * pos );
+//FNV-1a over the compact board and the turn
+
+void packCompactPosition( Position * posToPack, char buffer[ COMPACT_POSITION_SIZE ] );
+int unpackCompactPosition( char buffer[ COMPACT_POSITION_SIZE ], Position * posToUnpack );
+//compact wire format, unpacking returns -1 if the checksum does not match
+
+int packPositionDelta( Position * from, Position * to, char buffer[ MAX_DELTA_SIZE ] );
+//writes the delta from -> to and returns its length, -1 if it would not be shorter than a compact position
+
+int applyPositionDelta( char * buffer, int length, Position * pos );
+//returns -1 (pos unchanged) if the delta is malformed or the result does not match its checksum
+
+int recvServerMessage( ServerMessage * message, int protocol, int mySocket );
+//receives the next server message with its payload, returns its code (exits if the server is gone, like recvMsg)
+
+int sendMoveReply( Move * moveToSend, int protocol, int mySocket );
+//sendMove() in the negotiated protocol
+
+int sendNameReply( char textToSend[ MAX_NAME_LENGTH + 1 ], int offeredVersion, int mySocket );
+//answers NM_REQUEST_NAME, accepting v2 if it was offered; returns the protocol from now on
+
+int sendResync( Position * myPosition, int mySocket );
+//v2: asks for the server's position instead of sending a move, the answer is a delta or a new position
+
 int sendPosition( Position * posToSend, int mySocket );
 //used to send position struct
 
 void getPosition( Position * posToGet, int mySocket );
 //used to receive position struct
 
+/**********************************************************/
+int initReactor( Reactor * reactor );
+//creates the epoll set, returns -1 on failure
+
+int reactorAddListener( Reactor * reactor, int listenSocket, void * owner );
+//watches a listening socket (made non-blocking), its events carry owner
+
+int reactorAddConnection( Reactor * reactor, Connection * conn );
+//watches a connection, input always and output while something is queued
+
+int reactorWait( Reactor * reactor, ReactorEvent events[ MAX_REACTOR_EVENTS ], int timeout );
+//waits up to timeout ms (-1 forever) and returns the number of events (0 on timeout or signal)
+
+void initConnection( Connection * conn, int socket, void * owner );
+//wraps a connected socket and makes it non-blocking
+
+void closeConnection( Connection * conn );
+//stops watching the socket, closes it and drops both buffers
+
+int connectionRead( Connection * conn );
+//reads everything available, returns -1 if the peer closed or the buffer overflowed
+
+int connectionFlush( Connection * conn );
+//sends as much queued output as the socket accepts, returns -1 on a socket error
+
+int connectionFrame( Connection * conn, int frameType );
+//returns the length of the complete frame at the start of the input, 0 if it has not fully arrived
+//(v2 frames carry their length, frameType only matters for v1; an accept in front of a name switches to v2)
+
+char * connectionPayload( Connection * conn );
+//start of the payload of the frame connectionFrame() found
+
+int frameCode( Connection * conn );
+//NM_* code of the v2 frame connectionFrame() found, 0 for v1 frames (they carry none)
+
+int frameFits( Connection * conn, int frameType, int length );
+//TRUE if the frame connectionFrame() found is one a client sends for frameType (a v2 code and a payload
+//length that fit each other, v1 frames always do). Check it before frameCode() and the payload are used
+
+void connectionConsume( Connection * conn, int length );
+//drops a used frame from the input
+
+int queueBytes( Connection * conn, char * bytes, int length );
+//queues bytes, returns -1 if the connection is closed or its buffer is full. Nothing is sent until
+//connectionFlush(), so everything queued in one pass of the event loop leaves in a single send
+
+int queueMsg( Connection * conn, int msg );
+int queueMove( Connection * conn, Move * moveToSend );
+int queuePosition( Connection * conn, Position * posToSend );
+int queueName( Connection * conn, char textToSend[ MAX_NAME_LENGTH + 1 ] );
+//non-blocking sendMsg, sendMove, sendPosition and sendName (in the connection's protocol);
+//queueMove and queuePosition queue the whole message, NM_* code included
+
+int queueOffer( Connection * conn );
+//offers v2, send it right before NM_REQUEST_NAME and nothing else until the name is back
+
+int queueMoveRequest( Connection * conn, Move * opponentMove, Position * pos, int clock );
+//NM_REQUEST_MOVE, preceded by the opponent's move unless it is NULL: one v2 message, or the three v1 ones in one send
+//(pos is the position after that move, v2 sends its checksum)
+
+int queueResync( Connection * conn, char * clientPosition, Position * pos );
+//answers a NM_RESYNC payload: the cells of pos that differ (NM_POSITION_DELTA), or all of pos if that is shorter (NM_RESYNC_POSITION)
+
+void frameToMove( char * frame, Move * moveToGet );
+void frameToName( char * frame, char textToGet[ MAX_NAME_LENGTH + 1 ] );
+//decode a FRAME_MOVE / FRAME_NAME frame
+
 #endif
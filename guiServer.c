@@ -789,6 +789,7 @@ void resetButton_clicked( void )
 	gtk_widget_set_sensitive( GTK_WIDGET( playButton ), TRUE );
 
 	tempMove.tile[ 0 ] = NULL_MOVE;
+	initBoardTables();
 	initPosition( &gamePosition );
 	printToGui();
 
@@ -1330,6 +1331,7 @@ int main( int argc, char *argv[] )
 
 
 	tempMove.tile[ 0 ] = NULL_MOVE;
+	initBoardTables();
 	initPosition( &gamePosition );
 	printToGui();
 
@@ -0,0 +1,351 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "transposition.h"
+#include "pattern.h"
+#include "search.h"
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+
+
+/**********************************************************/
+// games are played in pairs on the same opening, engine A is WHITE in the first one
+#define DEFAULT_GAMES 100
+
+// random plies played from initPosition before the engines take over (-r)
+#define DEFAULT_RANDOM_PLIES 4
+
+// thinking time per move of both engines unless an engine sets its own (-T, or T= in -A/-B)
+#define DEFAULT_MATCH_MOVE_TIME 100
+
+#define DEFAULT_MATCH_TT_MEGABYTES 16
+
+// results sent by the workers, from engine A's point of view
+#define RESULT_WIN 'W'
+#define RESULT_DRAW 'D'
+#define RESULT_LOSS 'L'
+
+// max() macro
+#define max(a, b) ((a > b) ? a : b)
+/**********************************************************/
+
+/* One side of the match */
+typedef struct
+{
+	char * name;
+	SearchConfig config;
+	int hashMegabytes;
+	char * weightsFile;
+	EvaluationWeights weights;				// the engine's own copy, made the evaluation's on its moves
+	TranspositionTable table;				// the engine's own table, kept between its moves like a client does
+} Engine;
+
+Engine engines[ 2 ];
+
+int numberOfGames = DEFAULT_GAMES;
+int numberOfWorkers = 0;					// 0: one per online core
+int randomPlies = DEFAULT_RANDOM_PLIES;
+uint64_t matchSeed = 1;
+
+int wins = 0, draws = 0, losses = 0, played = 0;	// of engine A, as the results come in
+/**********************************************************/
+
+
+// --- Parse "key=value,key=value" engine options (T move ms, d depth, t threads, e endgame empties, a pvs|minimax, m MB, w weights file) ---
+int parseEngine( Engine * engine, char * spec )
+{
+	char * option;
+
+	for( option = strtok( spec, "," ); option != NULL; option = strtok( NULL, "," ) )
+	{
+		char * value = strchr( option, '=' );
+
+		if( value == NULL || value != option + 1 )
+		{
+			printf( "Bad engine option %s (expected key=value)\n", option );
+			return -1;
+		}
+		value++;
+
+		switch( option[ 0 ] )
+		{
+			case 'T':
+				engine->config.moveTime = atoi( value );
+				break;
+			case 'd':
+				engine->config.maxDepth = atoi( value );
+				if( engine->config.maxDepth < 1 || engine->config.maxDepth > MAX_SEARCH_DEPTH )
+				{
+					printf( "Depth must be between 1 and %d\n", MAX_SEARCH_DEPTH );
+					return -1;
+				}
+				break;
+			case 't':
+				engine->config.threads = atoi( value );
+				if( engine->config.threads < 1 || engine->config.threads > MAX_THREADS )
+				{
+					printf( "Threads must be between 1 and %d\n", MAX_THREADS );
+					return -1;
+				}
+				break;
+			case 'e':
+				engine->config.endgameEmpties = atoi( value );
+				break;
+			case 'a':
+				if( strcmp( value, "pvs" ) == 0 )
+					engine->config.algorithm = SEARCH_PVS;
+				else if( strcmp( value, "minimax" ) == 0 )
+					engine->config.algorithm = SEARCH_MINIMAX;
+				else
+				{
+					printf( "Unknown search algorithm %s (pvs or minimax)\n", value );
+					return -1;
+				}
+				break;
+			case 'm':
+				engine->hashMegabytes = atoi( value );
+				break;
+			case 'w':
+				engine->weightsFile = value;
+				break;
+			default:
+				printf( "Unknown engine option %c\n", option[ 0 ] );
+				return -1;
+		}
+	}
+
+	return 0;
+}
+
+// --- Load the weights of both engines (needs initPatterns(), default weights for engines without a file) ---
+int loadEngineWeights( void )
+{
+	EvaluationWeights * defaults = evaluationWeights;
+
+	for( int e = 0; e < 2; e++ )
+	{
+		// loadEvaluationWeights() reads into the weights evaluationWeights points to
+		engines[ e ].weights = *defaults;
+		evaluationWeights = &engines[ e ].weights;
+
+		if( engines[ e ].weightsFile != NULL && loadEvaluationWeights( engines[ e ].weightsFile ) < 0 )
+			return -1;
+	}
+
+	return 0;
+}
+
+// --- Make engine e the one getBestMove() uses ---
+void selectEngine( int e )
+{
+	searchConfig = engines[ e ].config;
+	selectTranspositionTable( &engines[ e ].table );
+	evaluationWeights = &engines[ e ].weights;
+}
+
+// --- Play one game, the same checks as server.c, returns the result for engine A ---
+char playGame( int game )
+{
+	Position pos;
+	Move move;
+	int pair = game / 2;
+	char colorOfA = ( game % 2 == 0 ) ? WHITE : BLACK;
+
+	// a pair whose opening ends the game gets the next seed, for both of its games
+	while( !gameOpening( &pos, randomPlies, matchSeed, pair ) )
+		pair += numberOfGames;
+
+	// new game: both engines forget everything, as a client does on NM_NEW_POSITION
+	for( int e = 0; e < 2; e++ )
+	{
+		selectEngine( e );
+		clearTranspositionTable();
+	}
+
+	while( canMove( &pos, WHITE ) || canMove( &pos, BLACK ) )
+	{
+		int e = ( pos.turn == colorOfA ) ? 0 : 1;
+
+		move.color = pos.turn;
+		if( !canMove( &pos, pos.turn ) )
+			move.tile[ 0 ] = NULL_MOVE;
+		else
+		{
+			selectEngine( e );
+			move = getBestMove( &pos, pos.turn );
+			move.color = pos.turn;
+
+			// technical loss
+			if( move.tile[ 0 ] == NULL_MOVE || !isLegalMove( &pos, &move ) )
+			{
+				printf( "Game %d: %s played an illegal move and lost\n", game + 1, engines[ e ].name );
+				return e == 0 ? RESULT_LOSS : RESULT_WIN;
+			}
+		}
+
+		doMove( &pos, &move );
+	}
+
+	if( pos.score[ ( int ) colorOfA ] > pos.score[ getOtherSide( ( int ) colorOfA ) ] )
+		return RESULT_WIN;
+	if( pos.score[ ( int ) colorOfA ] < pos.score[ getOtherSide( ( int ) colorOfA ) ] )
+		return RESULT_LOSS;
+	return RESULT_DRAW;
+}
+
+// --- Worker process: plays games worker, worker + workers, ... and writes one result byte per game ---
+void runWorker( int worker, int workers, int outputPipe )
+{
+	for( int e = 0; e < 2; e++ )
+		if( allocTranspositionTable( &engines[ e ].table, engines[ e ].hashMegabytes ) < 0 )
+			exit( 1 );
+
+	for( int game = worker; game < numberOfGames; game += workers )
+	{
+		char result = playGame( game );
+
+		if( write( outputPipe, &result, 1 ) != 1 )
+			exit( 1 );
+	}
+}
+
+// --- Elo difference for a score fraction ---
+double eloFromScore( double score )
+{
+	if( score <= 0.0 )
+		return -INFINITY;
+	if( score >= 1.0 )
+		return INFINITY;
+
+	return 400.0 * log10( score / ( 1.0 - score ) );
+}
+
+// --- W/D/L of engine A, Elo and its 95% interval (normal approximation over game scores) ---
+void printResults( int wins, int draws, int losses )
+{
+	int games = wins + draws + losses;
+	double score, deviation;
+
+	if( games == 0 )
+		return;
+
+	score = ( wins + 0.5 * draws ) / games;
+	deviation = sqrt( ( wins * pow( 1.0 - score, 2 ) + draws * pow( 0.5 - score, 2 ) + losses * pow( score, 2 ) ) / games ) / sqrt( games );
+
+	printf( "%s vs %s: %d games, +%d =%d -%d, score %.1f%%", engines[ 0 ].name, engines[ 1 ].name, games, wins, draws, losses, 100.0 * score );
+	printf( ", Elo %+.1f [%+.1f, %+.1f]\n", eloFromScore( score ), eloFromScore( score - 1.96 * deviation ), eloFromScore( score + 1.96 * deviation ) );
+}
+
+// --- Count a result sent by a worker, with running totals every tenth of the match ---
+void countResult( void * record )
+{
+	char result = *( char * ) record;
+
+	if( result == RESULT_WIN )
+		wins++;
+	else if( result == RESULT_DRAW )
+		draws++;
+	else
+		losses++;
+
+	if( ++played % max( numberOfGames / 10, 1 ) == 0 && played < numberOfGames )
+	{
+		printResults( wins, draws, losses );
+		fflush( stdout );
+	}
+}
+
+/**********************************************************/
+
+// --- Main ---
+int main( int argc, char ** argv )
+{
+	int c;
+	int moveTime = DEFAULT_MATCH_MOVE_TIME;
+	char * specs[ 2 ] = { NULL, NULL };
+	opterr = 0;
+
+	while( ( c = getopt ( argc, argv, "g:j:r:s:T:A:B:h" ) ) != -1 )
+		switch( c )
+		{
+			case 'h':
+				printf( "[-g number_of_games] [-j workers] [-r random_opening_plies] [-s seed] [-T move_time_ms] [-A engine_options] [-B engine_options]\n" );
+				printf( "engine options: comma separated T=move_time_ms d=depth t=threads e=endgame_empties a=pvs|minimax m=hash_table_MB w=weights_file\n" );
+				return 0;
+			case 'g':
+				numberOfGames = atoi( optarg );
+				break;
+			case 'j':
+				numberOfWorkers = atoi( optarg );
+				if( numberOfWorkers < 1 || numberOfWorkers > MAX_WORKERS )
+				{
+					printf( "Workers must be between 1 and %d\n", MAX_WORKERS );
+					return 1;
+				}
+				break;
+			case 'r':
+				randomPlies = atoi( optarg );
+				break;
+			case 's':
+				matchSeed = strtoull( optarg, NULL, 10 );
+				break;
+			case 'T':
+				moveTime = atoi( optarg );
+				break;
+			case 'A':
+				specs[ 0 ] = optarg;
+				break;
+			case 'B':
+				specs[ 1 ] = optarg;
+				break;
+			case '?':
+				if( optopt == 'g' || optopt == 'j' || optopt == 'r' || optopt == 's' || optopt == 'T' || optopt == 'A' || optopt == 'B' )
+					printf( "Option -%c requires an argument.\n", ( char ) optopt );
+				else if( isprint( optopt ) )
+					printf( "Unknown option -%c\n", ( char ) optopt );
+				else
+					printf( "Unknown option character -%c\n", ( char ) optopt );
+				return 1;
+			default:
+			return 1;
+		}
+
+	for( int e = 0; e < 2; e++ )
+	{
+		engines[ e ].name = e == 0 ? "A" : "B";
+		engines[ e ].config = searchConfig;
+		engines[ e ].config.moveTime = moveTime;
+		engines[ e ].hashMegabytes = DEFAULT_MATCH_TT_MEGABYTES;
+
+		if( specs[ e ] != NULL && parseEngine( &engines[ e ], specs[ e ] ) < 0 )
+			return 1;
+	}
+
+	if( numberOfWorkers == 0 )
+		numberOfWorkers = onlineWorkers( max( engines[ 0 ].config.threads, engines[ 1 ].config.threads ) );
+	if( numberOfWorkers > numberOfGames )
+		numberOfWorkers = numberOfGames > 0 ? numberOfGames : 1;
+
+	initBoardTables();
+	initPatterns();
+	initSearch();
+
+	if( loadEngineWeights() < 0 )
+		return 1;
+
+	printf( "%d games, %d workers, %d random plies, seed %llu\n", numberOfGames, numberOfWorkers, randomPlies, ( unsigned long long ) matchSeed );
+	fflush( stdout );
+
+	if( runWorkers( numberOfWorkers, runWorker, 1, countResult ) < 0 )
+		return 1;
+
+	printResults( wins, draws, losses );
+
+	return played == numberOfGames ? 0 : 1;
+}
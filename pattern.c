@@ -0,0 +1,372 @@
+#include "pattern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************/
+const int patternLength[ PATTERN_TYPES ] = { EDGE_LENGTH, DIAGONAL_LENGTH };
+const int patternOffset[ PATTERN_TYPES ] = { 0, 6561 };
+
+static EvaluationWeights loadedWeights;
+EvaluationWeights * evaluationWeights = &loadedWeights;
+
+/* The 6 corners in order around the hexagon, the direction of the edge to the next corner
+   and the direction towards the center (indices of directionShift) */
+static const int cornerCell[ 6 ][ 2 ] = { { 0, 7 }, { 0, 14 }, { 7, 14 }, { 14, 7 }, { 14, 0 }, { 7, 0 } };
+static const int edgeDirection[ 6 ] = { 3, 5, 4, 2, 0, 1 };
+static const int centerDirection[ 6 ] = { 5, 4, 2, 0, 1, 3 };
+
+static int instanceType[ PATTERN_INSTANCES ];
+static int instanceCells[ PATTERN_INSTANCES ][ MAX_PATTERN_LENGTH ];
+
+/* for every cell, the instances it belongs to and its power of 3 in each (a corner is in two edges and a diagonal) */
+#define MAX_PATTERNS_PER_CELL 3
+static int cellPatternCount[ BITBOARD_WORDS * 64 ];
+static int cellPatternInstance[ BITBOARD_WORDS * 64 ][ MAX_PATTERNS_PER_CELL ];
+static int cellPatternPower[ BITBOARD_WORDS * 64 ][ MAX_PATTERNS_PER_CELL ];
+
+static Bitboard patternCells;		//union of all instances, flips elsewhere are skipped
+
+/**********************************************************/
+static int power3( int n )
+{
+	int result = 1;
+
+	while( n-- > 0 )
+		result *= 3;
+
+	return result;
+}
+
+/**********************************************************/
+/* state of cell k in a base-3 index */
+static int cellState( int index, int k )
+{
+	return ( index / power3( k ) ) % 3;
+}
+
+/**********************************************************/
+/* sign of a cell state from WHITE's point of view */
+static int stateSign( int state )
+{
+	return ( state == 1 ) ? 1 : ( ( state == 2 ) ? -1 : 0 );
+}
+
+/**********************************************************/
+/* Hand-made weights used when no weights file is given: corners, discs next to an empty corner
+   and runs of discs anchored on a corner (these can never be flipped along the edge) */
+static void defaultFeatureWeights( short features[ 2 ][ EVALUATION_PHASES ][ EVALUATION_FEATURES ] )
+{
+	int phase, color;
+
+	for( phase = 0; phase < EVALUATION_PHASES; phase++ )
+		for( color = WHITE; color <= BLACK; color++ )
+		{
+			short * feature = features[ color ][ phase ];
+
+			/* the disc difference counts three times as much in the second half of the game */
+			feature[ FEATURE_DISCS ] = ( phase < EVALUATION_PHASES / 2 ) ? 1 : 3;
+
+			/* mobility is worth more to WHITE, stability to BLACK */
+			feature[ FEATURE_MOBILITY ] = ( color == WHITE ) ? 10 : 5;
+			feature[ FEATURE_FRONTIER ] = -2;
+			feature[ FEATURE_POTENTIAL ] = 2;
+			feature[ FEATURE_STABILITY ] = ( color == BLACK ) ? 8 : 3;
+		}
+}
+
+static void defaultWeights( EvaluationWeights * weights )
+{
+	int index, k, run, phase;
+	short * edge = weights->pattern[ 0 ] + patternOffset[ PATTERN_EDGE ];
+	short * diagonal = weights->pattern[ 0 ] + patternOffset[ PATTERN_DIAGONAL ];
+
+	defaultFeatureWeights( weights->feature );
+
+	for( index = 0; index < power3( EDGE_LENGTH ); index++ )
+	{
+		int value = 0;
+
+		for( k = 0; k < EDGE_LENGTH; k++ )
+			value += stateSign( cellState( index, k ) ) * ( ( k == 0 || k == EDGE_LENGTH - 1 ) ? 25 : 4 );
+
+		/* next to an empty corner */
+		if( cellState( index, 0 ) == 0 )
+			value -= 10 * stateSign( cellState( index, 1 ) );
+		if( cellState( index, EDGE_LENGTH - 1 ) == 0 )
+			value -= 10 * stateSign( cellState( index, EDGE_LENGTH - 2 ) );
+
+		/* anchored runs */
+		for( run = 1; run < EDGE_LENGTH && cellState( index, 0 ) != 0 && cellState( index, run ) == cellState( index, 0 ); run++ )
+			value += 6 * stateSign( cellState( index, 0 ) );
+		for( run = EDGE_LENGTH - 2; run >= 0 && cellState( index, EDGE_LENGTH - 1 ) != 0 && cellState( index, run ) == cellState( index, EDGE_LENGTH - 1 ); run-- )
+			value += 6 * stateSign( cellState( index, EDGE_LENGTH - 1 ) );
+
+		edge[ index ] = value;
+	}
+
+	/* the corner itself is counted by the edges */
+	for( index = 0; index < power3( DIAGONAL_LENGTH ); index++ )
+	{
+		int value = 0;
+
+		if( cellState( index, 0 ) == 0 )
+			value -= 15 * stateSign( cellState( index, 1 ) );
+		else if( cellState( index, 1 ) == cellState( index, 0 ) )
+			value += 3 * stateSign( cellState( index, 1 ) );
+
+		diagonal[ index ] = value;
+	}
+
+	for( phase = 1; phase < EVALUATION_PHASES; phase++ )
+		memcpy( weights->pattern[ phase ], weights->pattern[ 0 ], sizeof( weights->pattern[ 0 ] ) );
+}
+
+/**********************************************************/
+void initPatterns( void )
+{
+	int corner, k, instance, cell;
+
+	memset( cellPatternCount, 0, sizeof( cellPatternCount ) );
+	memset( &patternCells, 0, sizeof( Bitboard ) );
+
+	for( corner = 0; corner < 6; corner++ )
+	{
+		int origin = BIT_INDEX( cornerCell[ corner ][ 0 ], cornerCell[ corner ][ 1 ] );
+
+		instanceType[ corner ] = PATTERN_EDGE;
+		instanceType[ 6 + corner ] = PATTERN_DIAGONAL;
+
+		instanceCells[ corner ][ 0 ] = origin;
+		instanceCells[ 6 + corner ][ 0 ] = origin;
+
+		for( k = 1; k < EDGE_LENGTH; k++ )
+			instanceCells[ corner ][ k ] = rayCells[ origin ][ edgeDirection[ corner ] ][ k - 1 ];
+
+		for( k = 1; k < DIAGONAL_LENGTH; k++ )
+			instanceCells[ 6 + corner ][ k ] = rayCells[ origin ][ centerDirection[ corner ] ][ k - 1 ];
+	}
+
+	for( instance = 0; instance < PATTERN_INSTANCES; instance++ )
+		for( k = 0; k < patternLength[ instanceType[ instance ] ]; k++ )
+		{
+			cell = instanceCells[ instance ][ k ];
+
+			cellPatternInstance[ cell ][ cellPatternCount[ cell ] ] = instance;
+			cellPatternPower[ cell ][ cellPatternCount[ cell ] ] = power3( k );
+			cellPatternCount[ cell ]++;
+			bbSetBit( &patternCells, cell );
+		}
+
+	evaluationWeights = &loadedWeights;
+	defaultWeights( evaluationWeights );
+}
+
+/**********************************************************/
+/* reads the pattern tables of one phase (length and 3^length int16 per type) */
+static int readPatternTables( FILE * file, short * table )
+{
+	int length, type;
+
+	for( type = 0; type < PATTERN_TYPES; type++ )
+		if( fread( &length, sizeof( int ), 1, file ) != 1 || length != patternLength[ type ]
+			|| fread( table + patternOffset[ type ], sizeof( short ), power3( length ), file ) != ( size_t ) power3( length ) )
+			return -1;
+
+	return 0;
+}
+
+/**********************************************************/
+int loadEvaluationWeights( char * fileName )
+{
+	FILE * file;
+	char magic[ 4 ];
+	int version, types, phases, features, phase, failed = FALSE;
+	EvaluationWeights * weights;
+
+	if( ( file = fopen( fileName, "rb" ) ) == NULL )
+	{
+		printf( "ERROR: Could not open weights file %s\n", fileName );
+		return -1;
+	}
+
+	if( fread( magic, 1, 4, file ) != 4 || memcmp( magic, PATTERN_FILE_MAGIC, 4 ) != 0
+		|| fread( &version, sizeof( int ), 1, file ) != 1 || version < 1 || version > PATTERN_FILE_VERSION
+		|| fread( &types, sizeof( int ), 1, file ) != 1 || types != PATTERN_TYPES )
+	{
+		printf( "ERROR: %s is not a weights file of this version\n", fileName );
+		fclose( file );
+		return -1;
+	}
+
+	/* read into a copy, so that a bad file leaves the current weights alone */
+	if( ( weights = malloc( sizeof( EvaluationWeights ) ) ) == NULL )
+	{
+		printf( "ERROR: Out of memory\n" );
+		fclose( file );
+		return -1;
+	}
+
+	if( version == 1 )
+	{
+		/* one table per type and no features: the tables go to every phase, the features keep the built-in values */
+		defaultWeights( weights );
+		failed = readPatternTables( file, weights->pattern[ 0 ] ) < 0;
+
+		for( phase = 1; phase < EVALUATION_PHASES; phase++ )
+			memcpy( weights->pattern[ phase ], weights->pattern[ 0 ], sizeof( weights->pattern[ 0 ] ) );
+	}
+	else if( fread( &phases, sizeof( int ), 1, file ) != 1 || phases != EVALUATION_PHASES
+		|| fread( &features, sizeof( int ), 1, file ) != 1 || features != EVALUATION_FEATURES )
+	{
+		printf( "ERROR: %s has other phases or features than this program\n", fileName );
+		fclose( file );
+		free( weights );
+		return -1;
+	}
+	else
+		for( phase = 0; phase < EVALUATION_PHASES && !failed; phase++ )
+			failed = fread( weights->feature[ WHITE ][ phase ], sizeof( short ), EVALUATION_FEATURES, file ) != EVALUATION_FEATURES
+				|| fread( weights->feature[ BLACK ][ phase ], sizeof( short ), EVALUATION_FEATURES, file ) != EVALUATION_FEATURES
+				|| readPatternTables( file, weights->pattern[ phase ] ) < 0;
+
+	if( version == 2 )
+	{
+		/* version 2 weighted a neighbor-count stability, which computeStableDiscs() replaced: keep the built-in weight */
+		short defaults[ 2 ][ EVALUATION_PHASES ][ EVALUATION_FEATURES ];
+
+		defaultFeatureWeights( defaults );
+		for( phase = 0; phase < EVALUATION_PHASES; phase++ )
+		{
+			weights->feature[ WHITE ][ phase ][ FEATURE_STABILITY ] = defaults[ WHITE ][ phase ][ FEATURE_STABILITY ];
+			weights->feature[ BLACK ][ phase ][ FEATURE_STABILITY ] = defaults[ BLACK ][ phase ][ FEATURE_STABILITY ];
+		}
+	}
+
+	fclose( file );
+
+	if( failed )
+	{
+		printf( "ERROR: Weights file %s is truncated\n", fileName );
+		free( weights );
+		return -1;
+	}
+
+	*evaluationWeights = *weights;
+	free( weights );
+	return 0;
+}
+
+/**********************************************************/
+int saveEvaluationWeights( char * fileName )
+{
+	FILE * file;
+	int version = PATTERN_FILE_VERSION, types = PATTERN_TYPES, phases = EVALUATION_PHASES, features = EVALUATION_FEATURES;
+	int phase, type;
+
+	if( ( file = fopen( fileName, "wb" ) ) == NULL )
+	{
+		printf( "ERROR: Could not create weights file %s\n", fileName );
+		return -1;
+	}
+
+	fwrite( PATTERN_FILE_MAGIC, 1, 4, file );
+	fwrite( &version, sizeof( int ), 1, file );
+	fwrite( &types, sizeof( int ), 1, file );
+	fwrite( &phases, sizeof( int ), 1, file );
+	fwrite( &features, sizeof( int ), 1, file );
+
+	for( phase = 0; phase < EVALUATION_PHASES; phase++ )
+	{
+		fwrite( evaluationWeights->feature[ WHITE ][ phase ], sizeof( short ), EVALUATION_FEATURES, file );
+		fwrite( evaluationWeights->feature[ BLACK ][ phase ], sizeof( short ), EVALUATION_FEATURES, file );
+
+		for( type = 0; type < PATTERN_TYPES; type++ )
+		{
+			fwrite( &patternLength[ type ], sizeof( int ), 1, file );
+			fwrite( evaluationWeights->pattern[ phase ] + patternOffset[ type ], sizeof( short ), power3( patternLength[ type ] ), file );
+		}
+	}
+
+	if( fclose( file ) != 0 )
+	{
+		printf( "ERROR: Could not write weights file %s\n", fileName );
+		return -1;
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+void computePatternIndices( BitPosition * pos, PatternIndices * patterns )
+{
+	int instance, k, cell, index;
+
+	for( instance = 0; instance < PATTERN_INSTANCES; instance++ )
+	{
+		index = 0;
+
+		for( k = patternLength[ instanceType[ instance ] ] - 1; k >= 0; k-- )
+		{
+			cell = instanceCells[ instance ][ k ];
+			index = index * 3 + ( bbTestBit( pos->disc[ WHITE ], cell ) ? 1 : ( bbTestBit( pos->disc[ BLACK ], cell ) ? 2 : 0 ) );
+		}
+
+		patterns->index[ instance ] = index;
+	}
+}
+
+/**********************************************************/
+/* adds ( direction * change of state ) to the indices of every instance touched by the move */
+static void applyRecord( PatternIndices * patterns, UndoRecord * record, int direction )
+{
+	int placed = ( record->color == WHITE ) ? 1 : 2;
+	int flipChange = ( record->color == WHITE ) ? -1 : 1;		//black (2) becomes white (1) or the opposite
+	Bitboard flips;
+	int k, cell;
+
+	if( record->index == NULL_MOVE )
+		return;
+
+	for( k = 0; k < cellPatternCount[ record->index ]; k++ )
+		patterns->index[ cellPatternInstance[ record->index ][ k ] ] += direction * placed * cellPatternPower[ record->index ][ k ];
+
+	for( flips = bbAnd( record->flips, patternCells ); !bbIsEmpty( flips ); bbClearBit( &flips, cell ) )
+	{
+		cell = bbLowestBit( flips );
+
+		for( k = 0; k < cellPatternCount[ cell ]; k++ )
+			patterns->index[ cellPatternInstance[ cell ][ k ] ] += direction * flipChange * cellPatternPower[ cell ][ k ];
+	}
+}
+
+/**********************************************************/
+void updatePatternIndices( PatternIndices * patterns, UndoRecord * record )
+{
+	applyRecord( patterns, record, 1 );
+}
+
+/**********************************************************/
+void revertPatternIndices( PatternIndices * patterns, UndoRecord * record )
+{
+	applyRecord( patterns, record, -1 );
+}
+
+/**********************************************************/
+void patternWeightIndices( PatternIndices * patterns, int weightIndex[ PATTERN_INSTANCES ] )
+{
+	for( int instance = 0; instance < PATTERN_INSTANCES; instance++ )
+		weightIndex[ instance ] = patternOffset[ instanceType[ instance ] ] + patterns->index[ instance ];
+}
+
+/**********************************************************/
+int evaluatePatterns( PatternIndices * patterns, char color, int phase )
+{
+	short * table = evaluationWeights->pattern[ phase ];
+	int instance, value = 0;
+
+	for( instance = 0; instance < PATTERN_INSTANCES; instance++ )
+		value += table[ patternOffset[ instanceType[ instance ] ] + patterns->index[ instance ] ];
+
+	return ( color == WHITE ) ? value : -value;
+}
@@ -0,0 +1,86 @@
+#ifndef _PATTERN_H
+#define _PATTERN_H
+
+#include "global.h"
+#include "board.h"
+
+/**********************************************************/
+/* Pattern types: all instances of a type share one weight table */
+#define PATTERN_EDGE 0				//the 8 cells of an edge, from one corner to the next
+#define PATTERN_DIAGONAL 1			//a corner and the 6 cells towards the center
+#define PATTERN_TYPES 2
+
+#define EDGE_LENGTH ( HEX_BOARD_RADIUS + 1 )
+#define DIAGONAL_LENGTH HEX_BOARD_RADIUS
+#define MAX_PATTERN_LENGTH EDGE_LENGTH
+
+#define PATTERN_INSTANCES 12		//6 edges and 6 diagonals
+
+/* all tables of a phase back to back, 3^EDGE_LENGTH + 3^DIAGONAL_LENGTH weights */
+#define PATTERN_WEIGHTS ( 6561 + 2187 )
+
+/* Game phases: every phase has its own weights, picked by the number of discs on the board */
+#define EVALUATION_PHASES 4
+#define PLAYABLE_CELLS ( 3 * HEX_BOARD_RADIUS * ( HEX_BOARD_RADIUS + 1 ) + 1 )
+#define EVALUATION_PHASE( discs ) ( ( discs ) * EVALUATION_PHASES / ( PLAYABLE_CELLS + 1 ) )
+
+/* Features of evaluatePosition(), each counted as ( color's - opponent's ) */
+#define FEATURE_DISCS 0
+#define FEATURE_MOBILITY 1				//legal moves
+#define FEATURE_FRONTIER 2				//discs next to an empty cell
+#define FEATURE_POTENTIAL 3				//empty cells next to an opponent disc
+#define FEATURE_STABILITY 4				//stable discs (computeStableDiscs())
+#define EVALUATION_FEATURES 5
+
+#define PATTERN_FILE_MAGIC "HXPT"
+#define PATTERN_FILE_VERSION 3			//version 1 files (one pattern table per type, no features) still load,
+										//version 2 files (neighbor-count stability) keep the built-in stability weights
+
+#define DEFAULT_WEIGHTS_FILE "eval.weights"
+
+/**********************************************************/
+/* Base-3 index of every pattern instance (cell k contributes state * 3^k, state: 0 empty, 1 white, 2 black) */
+typedef struct
+{
+	unsigned short index[ PATTERN_INSTANCES ];
+} PatternIndices;
+
+/* Everything a weights file holds */
+typedef struct
+{
+	short feature[ 2 ][ EVALUATION_PHASES ][ EVALUATION_FEATURES ];		//by the color the search evaluates for
+	short pattern[ EVALUATION_PHASES ][ PATTERN_WEIGHTS ];				//3^length weights per type (patternOffset), from WHITE's point of view
+} EvaluationWeights;
+
+/**********************************************************/
+extern const int patternLength[ PATTERN_TYPES ];
+extern const int patternOffset[ PATTERN_TYPES ];
+extern EvaluationWeights * evaluationWeights;		//the weights evaluatePosition() uses, built-in defaults after initPatterns()
+
+/**********************************************************/
+void initPatterns( void );
+//builds the cell lists of every instance (needs initBoardTables()) and the default weights
+
+int loadEvaluationWeights( char * fileName );
+//replaces *evaluationWeights with the ones of a binary weights file, returns -1 (weights unchanged) if the file is missing or invalid
+
+int saveEvaluationWeights( char * fileName );
+//writes *evaluationWeights in the same format (magic, version, types, phases, features, then per phase
+//the feature weights of both colors and the length and 3^length int16 of every pattern type)
+
+void computePatternIndices( BitPosition * pos, PatternIndices * patterns );
+//computes the indices of a position from scratch
+
+void updatePatternIndices( PatternIndices * patterns, UndoRecord * record );
+//applies the move described by an undo record (call right after makeMove() with the record it pushed)
+
+void revertPatternIndices( PatternIndices * patterns, UndoRecord * record );
+//takes it back (call right before the matching unmakeMove())
+
+void patternWeightIndices( PatternIndices * patterns, int weightIndex[ PATTERN_INSTANCES ] );
+//where the weight of every instance is in a phase's pattern table
+
+int evaluatePatterns( PatternIndices * patterns, char color, int phase );
+//sum of the weights of all instances, from color's point of view
+
+#endif
@@ -0,0 +1,227 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <ctype.h>
+#include <unistd.h>
+
+
+/**********************************************************/
+// counts are printed for every depth up to this one (-d)
+#define DEFAULT_PERFT_DEPTH 6
+
+#define MAX_PERFT_DEPTH 32
+/**********************************************************/
+
+char * referenceFile = "perft.ref";	// expected leaf counts, one "depth count" line per depth
+
+int useBitboards = FALSE;			// -b: generateMoves() and makeMove() instead of doMove() and isLegalMove()
+
+long long referenceCount[ MAX_PERFT_DEPTH + 1 ];	// -1 where the reference has no count
+/**********************************************************/
+
+
+/*
+Leaf counting rules:
+	- a position at depth 0 is one leaf
+	- a side without a legal move plays the null move (like doAllDirections() does), if its opponent can move
+	- a finished game (neither side can move) is one leaf, whatever depth is left
+*/
+
+// --- Perft on the array board (doMove, isLegalMove, canMove) ---
+long long perft( Position * pos, int depth )
+{
+	Position next;
+	Move move;
+	long long leaves = 0;
+	int i, j, moved = FALSE;
+
+	if( depth == 0 )
+		return 1;
+
+	move.color = pos->turn;
+
+	for( i = 0; i < ARRAY_BOARD_SIZE; i++ )
+		for( j = 0; j < ARRAY_BOARD_SIZE; j++ )
+		{
+			move.tile[ 0 ] = i;
+			move.tile[ 1 ] = j;
+
+			if( !isLegalMove( pos, &move ) )
+				continue;
+
+			next = *pos;
+			doMove( &next, &move );
+			leaves += perft( &next, depth - 1 );
+			moved = TRUE;
+		}
+
+	if( moved )
+		return leaves;
+
+	// no legal move
+	if( !canMove( pos, getOtherSide( pos->turn ) ) )
+		return 1;
+
+	next = *pos;
+	move.tile[ 0 ] = NULL_MOVE;
+	doMove( &next, &move );
+	return perft( &next, depth - 1 );
+}
+
+// --- Perft on the bit position (generateMoves, makeMove, unmakeMove) ---
+long long bitPerft( BitPosition * pos, UndoStack * stack, int depth )
+{
+	Bitboard legal;
+	Move move;
+	long long leaves = 0;
+
+	if( depth == 0 )
+		return 1;
+
+	move.color = pos->turn;
+	legal = generateMoves( pos, pos->turn );
+
+	if( bbIsEmpty( legal ) )
+	{
+		if( bbIsEmpty( generateMoves( pos, getOtherSide( pos->turn ) ) ) )
+			return 1;
+
+		move.tile[ 0 ] = NULL_MOVE;
+		makeMove( pos, &move, stack );
+		leaves = bitPerft( pos, stack, depth - 1 );
+		unmakeMove( pos, stack );
+		return leaves;
+	}
+
+	while( !bbIsEmpty( legal ) )
+	{
+		int index = bbLowestBit( legal );
+		bbClearBit( &legal, index );
+
+		move.tile[ 0 ] = BIT_ROW( index );
+		move.tile[ 1 ] = BIT_COL( index );
+
+		makeMove( pos, &move, stack );
+		leaves += bitPerft( pos, stack, depth - 1 );
+		unmakeMove( pos, stack );
+	}
+
+	return leaves;
+}
+
+// --- Read the reference counts, a missing file only means nothing is checked ---
+void loadReference( void )
+{
+	FILE * file;
+	char line[ 256 ];
+	int depth;
+	long long count;
+
+	for( depth = 0; depth <= MAX_PERFT_DEPTH; depth++ )
+		referenceCount[ depth ] = -1;
+
+	if( ( file = fopen( referenceFile, "r" ) ) == NULL )
+	{
+		printf( "No reference counts (%s), nothing will be checked\n", referenceFile );
+		return;
+	}
+
+	// lines starting with # are comments
+	while( fgets( line, sizeof( line ), file ) != NULL )
+		if( line[ 0 ] != '#' && sscanf( line, "%d %lld", &depth, &count ) == 2 && depth >= 0 && depth <= MAX_PERFT_DEPTH )
+			referenceCount[ depth ] = count;
+
+	fclose( file );
+}
+
+/**********************************************************/
+
+// --- Main ---
+int main( int argc, char ** argv )
+{
+	int c, depth;
+	int maxDepth = DEFAULT_PERFT_DEPTH;
+	int mismatches = 0;
+	opterr = 0;
+
+	while( ( c = getopt ( argc, argv, "d:r:bh" ) ) != -1 )
+		switch( c )
+		{
+			case 'h':
+				printf( "[-d depth] [-r reference_file] [-b (bitboard move generator)]\n" );
+				return 0;
+			case 'd':
+				maxDepth = atoi( optarg );
+				if( maxDepth < 0 || maxDepth > MAX_PERFT_DEPTH )
+				{
+					printf( "Depth must be between 0 and %d\n", MAX_PERFT_DEPTH );
+					return 1;
+				}
+				break;
+			case 'r':
+				referenceFile = optarg;
+				break;
+			case 'b':
+				useBitboards = TRUE;
+				break;
+			case '?':
+				if( optopt == 'd' || optopt == 'r' )
+					printf( "Option -%c requires an argument.\n", ( char ) optopt );
+				else if( isprint( optopt ) )
+					printf( "Unknown option -%c\n", ( char ) optopt );
+				else
+					printf( "Unknown option character -%c\n", ( char ) optopt );
+				return 1;
+			default:
+			return 1;
+		}
+
+	initBoardTables();
+	loadReference();
+
+	printf( "%s move generator\n", useBitboards ? "bitboard" : "array board" );
+	printf( "depth          leaves        ms     leaves/s\n" );
+
+	for( depth = 0; depth <= maxDepth; depth++ )
+	{
+		Position pos;
+		BitPosition bitPos;
+		UndoStack stack;
+		struct timespec start, end;
+		long long leaves;
+		long ms;
+
+		initPosition( &pos );
+
+		clock_gettime( CLOCK_MONOTONIC, &start );
+		if( useBitboards )
+		{
+			positionToBitPosition( &pos, &bitPos );
+			stack.top = 0;
+			leaves = bitPerft( &bitPos, &stack, depth );
+		}
+		else
+			leaves = perft( &pos, depth );
+		clock_gettime( CLOCK_MONOTONIC, &end );
+
+		ms = ( end.tv_sec - start.tv_sec ) * 1000 + ( end.tv_nsec - start.tv_nsec ) / 1000000;
+
+		printf( "%5d  %14lld  %8ld  %11lld", depth, leaves, ms, leaves * 1000 / ( ms > 0 ? ms : 1 ) );
+
+		if( referenceCount[ depth ] < 0 )
+			printf( "\n" );
+		else if( referenceCount[ depth ] == leaves )
+			printf( "  ok\n" );
+		else
+		{
+			printf( "  MISMATCH (expected %lld)\n", referenceCount[ depth ] );
+			mismatches++;
+		}
+	}
+
+	return mismatches == 0 ? 0 : 1;
+}
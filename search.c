@@ -0,0 +1,1099 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "transposition.h"
+#include "pattern.h"
+#include "search.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+// the clock is read once every (NODES_PER_CLOCK_CHECK) nodes
+#define NODES_PER_CLOCK_CHECK 1024
+
+// below this many empty cells the solver orders moves by parity only, above it fastest-first
+#define FASTEST_FIRST_EMPTIES 7
+
+// larger than any disc difference
+#define ENDGAME_INFINITY 1000
+
+// the solver tries a stability cutoff from this many empty cells up (below, the subtrees are too small to pay for it)
+#define STABILITY_CUTOFF_EMPTIES 8
+
+// larger than any evaluation, small enough to negate
+#define SEARCH_INFINITY 1000000000
+
+// half width of the first aspiration window around the previous iteration's score
+#define ASPIRATION_WINDOW 50
+
+// ab-pruning flag
+#define AB_PRUNING TRUE
+
+// maximum number of moves to search
+#define MAX_MOVES_SEARCH 100
+
+// min(), max() macros
+#define max(a, b) ((a > b) ? a : b)
+#define min(a, b) ((a < b) ? a : b)
+
+
+/**********************************************************/
+SearchConfig searchConfig = { DEFAULT_MOVE_TIME, MAX_SEARCH_DEPTH, 1, DEFAULT_ENDGAME_EMPTIES, SEARCH_PVS };
+SearchInfo searchInfo;
+
+char rootColor;						// color we are searching for, scores are from its point of view
+struct timespec searchStart;		// when the current move search started
+atomic_int searchAborted;			// set when the budget runs out, the running iteration is then discarded
+atomic_long searchDeadline;			// ms after searchStart at which the search stops, 0 for none (no clock, or pondering)
+
+/* Pondering: while the opponent thinks, a search of our reply to its predicted move */
+pthread_t ponderThread;
+int ponderRunning = FALSE;			// only used by the thread that calls the ponder functions
+Position ponderPosition;			// after the predicted move
+Move ponderPrediction;
+char ponderColor;
+Move ponderMove;					// result of the ponder search
+/**********************************************************/
+
+/* State of one search thread. All threads search the same root and share only the transposition table */
+typedef struct
+{
+	int id;									// 0 is the main thread, it alone watches the clock
+	BitPosition position;					// working position, changed in place by make/unmake
+	UndoStack undoStack;
+	PatternIndices patterns;				// pattern indices of the working position
+	long long nodes;						// nodes visited by this thread during the current move search
+#ifdef SEARCH_STATS
+	long long leafEvaluations;				// counters of the current move search, summed into searchInfo
+	long long ttProbes;
+	long long ttHits;
+	long long ttCutoffs;
+	long long cutoffIndex[CUTOFF_INDEX_BINS];
+#endif
+
+	Move moves[MAX_MOVES_SEARCH];			// root moves, in this thread's order
+	int scores[MAX_MOVES_SEARCH];
+	int total_moves;
+
+	Move bestMove;							// result of the deepest completed iteration
+	int completedDepth;
+	int bestScore;							// its score, centre of the next aspiration window
+
+	short killers[MAX_SEARCH_DEPTH + 1][2];	// last two moves (bit indices) that caused a cutoff at each ply
+	int history[2][BITBOARD_WORDS * 64];	// cutoff counts of each color playing on each cell, weighted by depth
+} SearchThread;
+
+SearchThread threadState[MAX_THREADS];
+
+
+/* Minimax & Evaluation */
+
+// --- Milliseconds since the move search started ---
+long elapsedTime(void) {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (now.tv_sec - searchStart.tv_sec) * 1000 + (now.tv_nsec - searchStart.tv_nsec) / 1000000;
+}
+
+// --- Has the move budget run out? ---
+int outOfTime(void) {
+	long deadline = searchDeadline;
+
+	return deadline > 0 && elapsedTime() >= deadline;
+}
+
+// masks used by the evaluation function (built once by initEvaluation)
+Bitboard cornerCells;
+
+// --- Build the evaluation masks ---
+void initEvaluation(void) {
+	// On a 15x15 hexagonal board, there are 6 corners
+	// {0, 7} {0, 14} {7, 0} {7, 14} {14, 0} {14, 7}
+	int corners[6][2] = {{0, 7}, {0, 14}, {7, 0}, {7, 14}, {14, 0}, {14, 7}};
+
+	for (int i = 0; i < 6; i++)
+		bbSetBit(&cornerCells, BIT_INDEX(corners[i][0], corners[i][1]));
+}
+
+// --- Count the Legal moves available ---
+int countAvailableMoves(BitPosition *currentPosition, Move moves[], char color) {
+    int total_moves = 0;
+
+	// all legal moves at once, bits come out lowest first so the list stays in row-major order
+	Bitboard legal = generateMoves(currentPosition, color);
+
+	while (!bbIsEmpty(legal)) {
+		int index = bbLowestBit(legal);
+		bbClearBit(&legal, index);
+
+		// parse the move and store it
+		Move move = {{BIT_ROW(index), BIT_COL(index)}, color};
+		moves[total_moves] = move;
+
+		// increase moves counter
+		total_moves++;
+    }
+	// return the total number of moves available on each game state
+    return total_moves;
+}
+
+
+// --- Evaluation function (f) ---
+// int evaluatePosition(Position *currentPosition, char playerColor) {
+// 	// V(state) = #myDisks - #opponentDisks
+// 	int myAgentScore = currentPosition->score[(int)playerColor];
+// 	int opponentAgentScore = currentPosition->score[getOtherSide(playerColor)];
+// 	int stateValue = myAgentScore - opponentAgentScore;
+
+// 	return stateValue;
+// }
+
+
+// --- Features of the evaluation from color's point of view (see pattern.h) ---
+void computeEvaluationFeatures(BitPosition *currentPosition, char color, int features[EVALUATION_FEATURES]) {
+	// Enemy color
+	char enemyColor = getOtherSide(color);
+
+	// number of available moves, frontier discs and potential mobility of each player (one pass)
+	Mobility mobility;
+	computeMobility(currentPosition, &mobility);
+
+    // Disc difference #myDisks - #opponentDisks
+	features[FEATURE_DISCS] = bitScore(currentPosition, color) - bitScore(currentPosition, enemyColor);
+
+	features[FEATURE_MOBILITY] = mobility.moves[(int)color] - mobility.moves[(int)enemyColor];
+
+	// Frontier discs give the opponent moves later, empty cells next to enemy discs give us some
+	features[FEATURE_FRONTIER] = mobility.frontier[(int)color] - mobility.frontier[(int)enemyColor];
+	features[FEATURE_POTENTIAL] = mobility.potential[(int)color] - mobility.potential[(int)enemyColor];
+
+	// Stable discs: grown from the corners and edges along the three axes, these are ours until the end
+	Bitboard stable[2];
+	computeStableDiscs(currentPosition, stable);
+	features[FEATURE_STABILITY] = bbPopCount(stable[(int)color]) - bbPopCount(stable[(int)enemyColor]);
+}
+
+
+// --- Evaluation function (f) ---
+int evaluatePosition(BitPosition *currentPosition, PatternIndices *patterns, char color) {
+	// The game is divided into EVALUATION_PHASES phases by the number of discs on the board,
+	// every phase and every color we search for has its own weights (built-in or from a weights file)
+	int features[EVALUATION_FEATURES];
+	int phase = EVALUATION_PHASE(bitScore(currentPosition, WHITE) + bitScore(currentPosition, BLACK));
+	short *weights = evaluationWeights->feature[(int)color][phase];
+
+	// F-score of state
+	int stateValue = 0;
+
+	computeEvaluationFeatures(currentPosition, color, features);
+
+	for (int f = 0; f < EVALUATION_FEATURES; f++)
+		stateValue += weights[f] * features[f];
+
+    // corners and edges: table lookups of the 6 edges and the 6 corner diagonals (see pattern.c)
+	stateValue += evaluatePatterns(patterns, color, phase);
+
+    return stateValue;
+}
+
+
+// --- Play a move on the thread's working position, keeping the pattern indices in step ---
+void searchMakeMove(SearchThread *thread, Move *move) {
+	makeMove(&thread->position, move, &thread->undoStack);
+	updatePatternIndices(&thread->patterns, &thread->undoStack.record[thread->undoStack.top - 1]);
+}
+
+// --- Take back the last searchMakeMove ---
+void searchUnmakeMove(SearchThread *thread) {
+	revertPatternIndices(&thread->patterns, &thread->undoStack.record[thread->undoStack.top - 1]);
+	unmakeMove(&thread->position, &thread->undoStack);
+}
+
+// --- Move ordering: TT move, corners, killer moves, then history ---
+void orderMoves(SearchThread *thread, Move moves[], int total_moves, int tt_move) {
+	int ply = thread->undoStack.top;
+	int keys[MAX_MOVES_SEARCH];
+
+	for (int i = 0; i < total_moves; i++) {
+		int index = BIT_INDEX(moves[i].tile[0], moves[i].tile[1]);
+
+		if (index == tt_move)
+			keys[i] = 1 << 30;
+		else if (bbTestBit(cornerCells, index))
+			keys[i] = 1 << 29;
+		else if (index == thread->killers[ply][0])
+			keys[i] = (1 << 28) + 1;
+		else if (index == thread->killers[ply][1])
+			keys[i] = 1 << 28;
+		else
+			keys[i] = thread->history[(int)moves[i].color][index];
+	}
+
+	// few moves, insertion sort (stable, equal keys keep the row-major order)
+	for (int i = 1; i < total_moves; i++) {
+		Move move = moves[i];
+		int key = keys[i];
+		int j;
+
+		for (j = i; j > 0 && keys[j - 1] < key; j--) {
+			moves[j] = moves[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		moves[j] = move;
+		keys[j] = key;
+	}
+}
+
+// --- A move refuted its parent: remember it for its siblings and the rest of the search ---
+void rememberCutoff(SearchThread *thread, Move *move, int depth) {
+	int ply = thread->undoStack.top;
+	int index = BIT_INDEX(move->tile[0], move->tile[1]);
+
+	if (thread->killers[ply][0] != index) {
+		thread->killers[ply][1] = thread->killers[ply][0];
+		thread->killers[ply][0] = index;
+	}
+
+	// kept well below the killer keys
+	if (thread->history[(int)move->color][index] < (1 << 27))
+		thread->history[(int)move->color][index] += depth * depth;
+}
+
+// --- Minimax Algorithm ---
+int minimax(SearchThread *thread, int depth, int alpha, int beta, int maximizingPlayer) {
+	BitPosition *currentPosition = &thread->position;
+
+	// -> Out of time? the result is thrown away anyway
+	if ((++thread->nodes % NODES_PER_CLOCK_CHECK) == 0 && thread->id == 0 && outOfTime())
+		searchAborted = TRUE;
+	if (searchAborted)
+		return 0;
+
+	// -> Break condition
+	// -> Reached maximum depth or no more moves possible
+	if (depth == 0 || (!canBitMove(currentPosition, WHITE) && !canBitMove(currentPosition, BLACK))) {
+		SEARCH_STAT(thread->leafEvaluations++);
+        return evaluatePosition(currentPosition, &thread->patterns, rootColor);
+	}
+
+	// -> Already searched deep enough through another move order?
+	TTData stored;
+	int tt_move = TT_NO_MOVE;
+	SEARCH_STAT(thread->ttProbes++);
+	if (probeTransposition(currentPosition->hash, &stored)) {
+		tt_move = fromCanonicalCell(currentPosition, stored.move);
+		SEARCH_STAT(thread->ttHits++);
+
+		if (stored.depth >= depth && (stored.bound == TT_EXACT
+			|| (stored.bound == TT_LOWER && stored.score >= beta)
+			|| (stored.bound == TT_UPPER && stored.score <= alpha))) {
+			SEARCH_STAT(thread->ttCutoffs++);
+			return stored.score;
+		}
+	}
+
+	// -> Get all available moves
+    Move moves[MAX_MOVES_SEARCH];
+    int total_available_moves = countAvailableMoves(currentPosition, moves, maximizingPlayer ? rootColor : getOtherSide(rootColor));
+
+	// If not moves are available then, evaluate current position and return
+    if (total_available_moves == 0) {
+		SEARCH_STAT(thread->leafEvaluations++);
+        return evaluatePosition(currentPosition, &thread->patterns, rootColor);
+	}
+
+    // -> Most promising moves first, so that cutoffs come early
+    orderMoves(thread, moves, total_available_moves, tt_move);
+
+    // window we were called with, to tell which kind of bound the result is
+    int original_alpha = alpha;
+    int original_beta = beta;
+
+    int best_f_score;
+    int best_move = 0;
+
+    if (maximizingPlayer) {
+		// -> Maximize the score, starting from -infinity(or the lowest possible value)
+        best_f_score = INT_MIN;
+
+		for (int i = 0; i < total_available_moves; i++) {
+			// make the move in place
+			searchMakeMove(thread, &moves[i]);
+
+			// starting minimax on that move, with the other player turn
+			int current_move_evaluation = minimax(thread, depth - 1, alpha, beta, FALSE);
+
+			// take it back
+			searchUnmakeMove(thread);
+
+			if (searchAborted)
+				return 0;
+
+			if (current_move_evaluation > best_f_score) {
+				best_f_score = current_move_evaluation;
+				best_move = i;
+			}
+
+			if (AB_PRUNING) {
+				alpha = max(current_move_evaluation, alpha);
+
+				// pruning, saving time
+				if (beta <= alpha) {
+					rememberCutoff(thread, &moves[i], depth);
+					SEARCH_STAT(thread->cutoffIndex[min(i, CUTOFF_INDEX_BINS - 1)]++);
+					break;
+				}
+			}
+        }
+    }
+	else {
+		// -> Minimize the score, starting from +infinity(or the highest possible value)
+        best_f_score = INT_MAX;
+
+		for (int i = 0; i < total_available_moves; i++) {
+			// make the move in place
+			searchMakeMove(thread, &moves[i]);
+
+			// starting minimax on that move, with the other player turn
+            int current_move_evaluation = minimax(thread, depth - 1, alpha, beta, TRUE);
+
+			// take it back
+			searchUnmakeMove(thread);
+
+			if (searchAborted)
+				return 0;
+
+			if (current_move_evaluation < best_f_score) {
+				best_f_score = current_move_evaluation;
+				best_move = i;
+			}
+
+			if (AB_PRUNING) {
+            	beta = min(current_move_evaluation, beta);
+
+				// pruning, saving time
+				if (beta <= alpha) {
+					rememberCutoff(thread, &moves[i], depth);
+					SEARCH_STAT(thread->cutoffIndex[min(i, CUTOFF_INDEX_BINS - 1)]++);
+					break;
+				}
+			}
+        }
+    }
+
+	// -> Remember the result for transpositions
+	int bound = TT_EXACT;
+	if (best_f_score <= original_alpha)
+		bound = TT_UPPER;
+	else if (best_f_score >= original_beta)
+		bound = TT_LOWER;
+
+	storeTransposition(currentPosition->hash, depth, bound, best_f_score, toCanonicalCell(currentPosition, BIT_INDEX(moves[best_move].tile[0], moves[best_move].tile[1])));
+
+    return best_f_score;
+}
+
+
+
+// --- Evaluation from the point of view of the side to move (for negamax) ---
+int evaluateForSideToMove(SearchThread *thread) {
+	SEARCH_STAT(thread->leafEvaluations++);
+
+	int value = evaluatePosition(&thread->position, &thread->patterns, rootColor);
+
+	return (thread->position.turn == rootColor) ? value : -value;
+}
+
+// --- Principal Variation Search: negamax, first move with the full window, the rest with null windows ---
+// TT scores are stored from the side to move's point of view here (the hash includes the turn)
+int principalVariationSearch(SearchThread *thread, int depth, int alpha, int beta) {
+	BitPosition *currentPosition = &thread->position;
+
+	// -> Out of time? the result is thrown away anyway
+	if ((++thread->nodes % NODES_PER_CLOCK_CHECK) == 0 && thread->id == 0 && outOfTime())
+		searchAborted = TRUE;
+	if (searchAborted)
+		return 0;
+
+	// -> Reached maximum depth or no more moves possible
+	if (depth == 0 || (!canBitMove(currentPosition, WHITE) && !canBitMove(currentPosition, BLACK)))
+		return evaluateForSideToMove(thread);
+
+	// -> Already searched deep enough through another move order?
+	TTData stored;
+	int tt_move = TT_NO_MOVE;
+	SEARCH_STAT(thread->ttProbes++);
+	if (probeTransposition(currentPosition->hash, &stored)) {
+		tt_move = fromCanonicalCell(currentPosition, stored.move);
+		SEARCH_STAT(thread->ttHits++);
+
+		if (stored.depth >= depth && (stored.bound == TT_EXACT
+			|| (stored.bound == TT_LOWER && stored.score >= beta)
+			|| (stored.bound == TT_UPPER && stored.score <= alpha))) {
+			SEARCH_STAT(thread->ttCutoffs++);
+			return stored.score;
+		}
+	}
+
+	Move moves[MAX_MOVES_SEARCH];
+	int total_available_moves = countAvailableMoves(currentPosition, moves, currentPosition->turn);
+
+	// same as minimax: a side without moves is evaluated, not passed
+	if (total_available_moves == 0)
+		return evaluateForSideToMove(thread);
+
+	orderMoves(thread, moves, total_available_moves, tt_move);
+
+	int original_alpha = alpha;
+	int best_score = -SEARCH_INFINITY;
+	int best_move = 0;
+
+	for (int i = 0; i < total_available_moves; i++) {
+		int score;
+
+		searchMakeMove(thread, &moves[i]);
+
+		if (i == 0)
+			score = -principalVariationSearch(thread, depth - 1, -beta, -alpha);
+		else {
+			// prove the move is no better than the first one, search it properly only if it is
+			score = -principalVariationSearch(thread, depth - 1, -alpha - 1, -alpha);
+			if (score > alpha && score < beta)
+				score = -principalVariationSearch(thread, depth - 1, -beta, -alpha);
+		}
+
+		searchUnmakeMove(thread);
+
+		if (searchAborted)
+			return 0;
+
+		if (score > best_score) {
+			best_score = score;
+			best_move = i;
+
+			if (score > alpha)
+				alpha = score;
+
+			if (alpha >= beta) {
+				rememberCutoff(thread, &moves[i], depth);
+				SEARCH_STAT(thread->cutoffIndex[min(i, CUTOFF_INDEX_BINS - 1)]++);
+				break;
+			}
+		}
+	}
+
+	int bound = TT_EXACT;
+	if (best_score <= original_alpha)
+		bound = TT_UPPER;
+	else if (best_score >= beta)
+		bound = TT_LOWER;
+
+	storeTransposition(currentPosition->hash, depth, bound, best_score, toCanonicalCell(currentPosition, BIT_INDEX(moves[best_move].tile[0], moves[best_move].tile[1])));
+
+	return best_score;
+}
+
+
+/* Endgame solver: negamax on the final disc difference of the side to move */
+
+// --- Final disc difference for the side to move ---
+int finalScore(BitPosition *position) {
+	return bitScore(position, position->turn) - bitScore(position, getOtherSide(position->turn));
+}
+
+// --- Last empty cell: whoever can play it does, nothing else to search ---
+int solveLastEmpty(BitPosition *position, int index) {
+	char color = position->turn;
+	int own = bitScore(position, color);
+	int enemy = bitScore(position, getOtherSide(color));
+
+	int flipped = bbPopCount(computeFlips(position, index, color));
+	if (flipped)
+		return (own + flipped + 1) - (enemy - flipped);
+
+	flipped = bbPopCount(computeFlips(position, index, getOtherSide(color)));
+	if (flipped)
+		return (own - flipped) - (enemy + flipped + 1);
+
+	return own - enemy;
+}
+
+// --- Two or three empty cells: try each cell directly, no move generation and no ordering ---
+int solveFewEmpties(SearchThread *thread, int alpha, int beta, int passed) {
+	BitPosition *position = &thread->position;
+	Bitboard empty = bbEmptyCells(position);
+
+	thread->nodes++;
+
+	if (bbPopCount(empty) == 1)
+		return solveLastEmpty(position, bbLowestBit(empty));
+
+	int best_score = -ENDGAME_INFINITY;
+
+	while (!bbIsEmpty(empty)) {
+		int index = bbLowestBit(empty);
+		bbClearBit(&empty, index);
+
+		Move move = {{BIT_ROW(index), BIT_COL(index)}, position->turn};
+		if (!makeMove(position, &move, &thread->undoStack)) {
+			unmakeMove(position, &thread->undoStack);
+			continue;
+		}
+
+		int score = -solveFewEmpties(thread, -beta, -alpha, FALSE);
+		unmakeMove(position, &thread->undoStack);
+
+		if (score > best_score) {
+			best_score = score;
+			if (score > alpha)
+				alpha = score;
+			if (alpha >= beta)
+				return best_score;
+		}
+	}
+
+	if (best_score > -ENDGAME_INFINITY)
+		return best_score;
+
+	// no move: the game is over if the opponent could not move either, else we pass
+	if (passed)
+		return finalScore(position);
+
+	Move pass = {{NULL_MOVE, 0}, position->turn};
+	makeMove(position, &pass, &thread->undoStack);
+	best_score = -solveFewEmpties(thread, -beta, -alpha, TRUE);
+	unmakeMove(position, &thread->undoStack);
+
+	return best_score;
+}
+
+// --- Empty cells in regions (connected through the six directions) with an odd number of cells ---
+Bitboard oddRegions(Bitboard empty) {
+	Bitboard odd = {{0}};
+
+	while (!bbIsEmpty(empty)) {
+		Bitboard region = {{0}};
+		Bitboard grown = {{0}};
+		bbSetBit(&grown, bbLowestBit(empty));
+
+		// grow one cell in every direction until the region stops changing
+		while (!bbIsEmpty(bbXor(grown, region))) {
+			region = grown;
+			for (int d = 0; d < 6; d++)
+				grown = bbOr(grown, bbAnd(bbShift(region, directionShift[d]), empty));
+		}
+
+		if (bbPopCount(region) % 2)
+			odd = bbOr(odd, region);
+		empty = bbAndNot(empty, region);
+	}
+
+	return odd;
+}
+
+// --- Endgame move ordering: odd regions first, and fastest-first (fewest opponent replies) when it pays off ---
+void orderEndgameMoves(SearchThread *thread, Move moves[], int total_moves, int empties) {
+	BitPosition *position = &thread->position;
+	Bitboard odd = oddRegions(bbEmptyCells(position));
+	int keys[MAX_MOVES_SEARCH];
+
+	for (int i = 0; i < total_moves; i++) {
+		keys[i] = bbTestBit(odd, BIT_INDEX(moves[i].tile[0], moves[i].tile[1])) ? 1 : 0;
+
+		if (empties > FASTEST_FIRST_EMPTIES) {
+			makeMove(position, &moves[i], &thread->undoStack);
+			keys[i] -= 2 * bbPopCount(generateMoves(position, position->turn));
+			unmakeMove(position, &thread->undoStack);
+		}
+	}
+
+	for (int i = 1; i < total_moves; i++) {
+		Move move = moves[i];
+		int key = keys[i];
+		int j;
+
+		for (j = i; j > 0 && keys[j - 1] < key; j--) {
+			moves[j] = moves[j - 1];
+			keys[j] = keys[j - 1];
+		}
+		moves[j] = move;
+		keys[j] = key;
+	}
+}
+
+// --- Exact search to the end of the game, returns the final disc difference for the side to move ---
+int solveEndgame(SearchThread *thread, int alpha, int beta, int passed) {
+	BitPosition *position = &thread->position;
+
+	// -> Out of time? the result is thrown away anyway
+	if ((++thread->nodes % NODES_PER_CLOCK_CHECK) == 0 && thread->id == 0 && outOfTime())
+		searchAborted = TRUE;
+	if (searchAborted)
+		return 0;
+
+	int empties = bbPopCount(bbEmptyCells(position));
+	if (empties <= 3)
+		return solveFewEmpties(thread, alpha, beta, passed);
+
+	// Stability cutoff: the opponent ends with at least its stable discs, which caps our final difference.
+	// Only worth computing when even all of its discs being stable could reach alpha
+	char opponent = getOtherSide(position->turn);
+	int cells = bitScore(position, WHITE) + bitScore(position, BLACK) + empties;
+
+	if (empties >= STABILITY_CUTOFF_EMPTIES && cells - 2 * bitScore(position, opponent) <= alpha) {
+		Bitboard stable[2];
+		computeStableDiscs(position, stable);
+
+		int bound = cells - 2 * bbPopCount(stable[(int)opponent]);
+		if (bound <= alpha)
+			return bound;
+	}
+
+	Move moves[MAX_MOVES_SEARCH];
+	int total_moves = countAvailableMoves(position, moves, position->turn);
+
+	if (total_moves == 0) {
+		// the game is over if the opponent could not move either, else we pass
+		if (passed)
+			return finalScore(position);
+
+		Move pass = {{NULL_MOVE, 0}, position->turn};
+		makeMove(position, &pass, &thread->undoStack);
+		int score = -solveEndgame(thread, -beta, -alpha, TRUE);
+		unmakeMove(position, &thread->undoStack);
+
+		return score;
+	}
+
+	orderEndgameMoves(thread, moves, total_moves, empties);
+
+	int best_score = -ENDGAME_INFINITY;
+
+	for (int i = 0; i < total_moves; i++) {
+		makeMove(position, &moves[i], &thread->undoStack);
+		int score = -solveEndgame(thread, -beta, -alpha, FALSE);
+		unmakeMove(position, &thread->undoStack);
+
+		if (searchAborted)
+			return 0;
+
+		if (score > best_score) {
+			best_score = score;
+			if (score > alpha)
+				alpha = score;
+			if (alpha >= beta) {
+				SEARCH_STAT(thread->cutoffIndex[min(i, CUTOFF_INDEX_BINS - 1)]++);
+				break;
+			}
+		}
+	}
+
+	return best_score;
+}
+
+// --- Solve every root move exactly, returns the best one (the best fully solved one if time runs out) ---
+Move solveEndgameRoot(SearchThread *thread) {
+	int best_score = -ENDGAME_INFINITY;
+
+	orderEndgameMoves(thread, thread->moves, thread->total_moves, bbPopCount(bbEmptyCells(&thread->position)));
+	Move bestMove = thread->moves[0];
+
+	for (int i = 0; i < thread->total_moves; i++) {
+		makeMove(&thread->position, &thread->moves[i], &thread->undoStack);
+		int score = -solveEndgame(thread, -ENDGAME_INFINITY, -best_score, FALSE);
+		unmakeMove(&thread->position, &thread->undoStack);
+
+		if (searchAborted)
+			break;
+
+		if (score > best_score) {
+			best_score = score;
+			bestMove = thread->moves[i];
+		}
+	}
+
+	thread->bestScore = best_score;
+	return bestMove;
+}
+
+
+// --- Order root moves by the scores of the last iteration (best first, stable) ---
+void sortRootMoves(Move moves[], int scores[], int total_moves) {
+	for (int i = 1; i < total_moves; i++) {
+		Move move = moves[i];
+		int score = scores[i];
+		int j;
+
+		for (j = i; j > 0 && scores[j - 1] < score; j--) {
+			moves[j] = moves[j - 1];
+			scores[j] = scores[j - 1];
+		}
+		moves[j] = move;
+		scores[j] = score;
+	}
+}
+
+
+// --- Search the root moves to a fixed depth, returns the best score (or leaves searchAborted set) ---
+int searchRoot(SearchThread *thread, int depth, Move *bestMove) {
+
+	// minimax parameters
+    int best_move_scored = INT_MIN;
+    int alpha = INT_MIN;
+    int beta = INT_MAX;
+
+    for (int i = 0; i < thread->total_moves; i++) {
+        // make the move in place
+		searchMakeMove(thread, &thread->moves[i]);
+
+		// start minimax (the move is already applied) and see if it's a good move
+		int current_move_evaluation = minimax(thread, depth - 1, alpha, beta, FALSE);
+
+		searchUnmakeMove(thread);
+
+		if (searchAborted)
+			return best_move_scored;
+
+		thread->scores[i] = current_move_evaluation;
+
+        // if a better move is found update the best move
+		if (current_move_evaluation > best_move_scored) {
+            best_move_scored = current_move_evaluation;
+            *bestMove = thread->moves[i];
+        }
+
+		if (AB_PRUNING) {
+			// update alpha
+			alpha = max(current_move_evaluation, alpha);
+
+			// else prune occurs
+			if (beta <= alpha)
+				break;
+		}
+    }
+
+	return best_move_scored;
+}
+
+
+// --- PVS at the root within [alpha, beta], returns the best score (or leaves searchAborted set) ---
+int searchRootPVS(SearchThread *thread, int depth, int alpha, int beta, Move *bestMove) {
+	int best_score = -SEARCH_INFINITY;
+
+	for (int i = 0; i < thread->total_moves; i++) {
+		int score;
+
+		searchMakeMove(thread, &thread->moves[i]);
+
+		if (i == 0)
+			score = -principalVariationSearch(thread, depth - 1, -beta, -alpha);
+		else {
+			score = -principalVariationSearch(thread, depth - 1, -alpha - 1, -alpha);
+			if (score > alpha && score < beta)
+				score = -principalVariationSearch(thread, depth - 1, -beta, -alpha);
+		}
+
+		searchUnmakeMove(thread);
+
+		if (searchAborted)
+			return best_score;
+
+		thread->scores[i] = score;
+
+		if (score > best_score) {
+			best_score = score;
+			*bestMove = thread->moves[i];
+
+			if (score > alpha)
+				alpha = score;
+			if (alpha >= beta)
+				break;
+		}
+	}
+
+	return best_score;
+}
+
+// --- Aspiration windows: search around the last score, widen on the failing side until the score falls inside ---
+int aspirationSearch(SearchThread *thread, int depth, Move *bestMove) {
+	int delta = ASPIRATION_WINDOW;
+	int alpha = -SEARCH_INFINITY;
+	int beta = SEARCH_INFINITY;
+
+	// no previous score on the first iteration
+	if (thread->completedDepth > 0) {
+		alpha = max(thread->bestScore - delta, -SEARCH_INFINITY);
+		beta = min(thread->bestScore + delta, SEARCH_INFINITY);
+	}
+
+	while (TRUE) {
+		Move candidate = *bestMove;
+		int score = searchRootPVS(thread, depth, alpha, beta, &candidate);
+
+		if (searchAborted)
+			return score;
+
+		delta *= 2;
+
+		if (score <= alpha)
+			alpha = max(alpha - delta, -SEARCH_INFINITY);
+		else if (score >= beta) {
+			beta = min(beta + delta, SEARCH_INFINITY);
+			*bestMove = candidate;
+		}
+		else {
+			*bestMove = candidate;
+			return score;
+		}
+	}
+}
+
+
+// --- Iterative deepening of one thread ---
+void *iterativeDeepening(void *argument) {
+	SearchThread *thread = argument;
+
+	// searching past the end of the game gives the same result again
+	int empty_cells = bbPopCount(bbEmptyCells(&thread->position));
+
+	// helpers start one ply deeper every other thread so that they fill the table ahead of the main thread
+	for (int depth = 1 + (thread->id % 2); depth <= searchConfig.maxDepth && depth <= empty_cells; depth++) {
+		Move iterationBest = thread->bestMove;
+		int best_move_scored;
+
+		if (searchConfig.algorithm == SEARCH_PVS)
+			best_move_scored = aspirationSearch(thread, depth, &iterationBest);
+		else
+			best_move_scored = searchRoot(thread, depth, &iterationBest);
+
+		// keep the move of the last completed iteration
+		if (searchAborted)
+			break;
+
+		thread->bestMove = iterationBest;
+		thread->completedDepth = depth;
+		thread->bestScore = best_move_scored;
+		if (thread->id == 0)
+			searchInfo.depthTime[depth] = elapsedTime();
+		storeTransposition(thread->position.hash, depth, TT_EXACT, best_move_scored, toCanonicalCell(&thread->position, BIT_INDEX(iterationBest.tile[0], iterationBest.tile[1])));
+
+		// next iteration starts from the best moves of this one
+		sortRootMoves(thread->moves, thread->scores, thread->total_moves);
+
+		// the next iteration takes longer than all previous ones together, don't start what we can't finish
+		long deadline = searchDeadline;
+		if (thread->id == 0 && deadline > 0 && elapsedTime() * 2 >= deadline)
+			break;
+	}
+
+	// the main thread is done, so is everybody else
+	if (thread->id == 0)
+		searchAborted = TRUE;
+
+	return NULL;
+}
+
+
+#ifdef SEARCH_STATS
+// --- Add the counters of one thread to searchInfo ---
+void addSearchStats(SearchThread *thread) {
+	searchInfo.leafEvaluations += thread->leafEvaluations;
+	searchInfo.ttProbes += thread->ttProbes;
+	searchInfo.ttHits += thread->ttHits;
+	searchInfo.ttCutoffs += thread->ttCutoffs;
+	for (int i = 0; i < CUTOFF_INDEX_BINS; i++)
+		searchInfo.cutoffIndex[i] += thread->cutoffIndex[i];
+}
+#endif
+
+// --- Search a position until searchAborted (searchStart and searchDeadline are set by the caller) ---
+Move searchPosition(Position *gamePosition, char color) {
+	pthread_t helpers[MAX_THREADS];
+	SearchThread *mainThread = &threadState[0];
+
+	rootColor = color;
+	memset(&searchInfo, 0, sizeof(searchInfo));
+
+	// the search runs on the compact bitboard representation
+	positionToBitPosition(gamePosition, &mainThread->position);
+	computePatternIndices(&mainThread->position, &mainThread->patterns);
+
+	// get all available moves for the current player
+    mainThread->total_moves = countAvailableMoves(&mainThread->position, mainThread->moves, color);
+
+	// assume a perfect move
+	Move bestMove;
+
+	// if no moves are available, return a null move
+	if (mainThread->total_moves == 0) {
+		bestMove.tile[0] = NULL_MOVE;
+		return bestMove;
+	}
+
+	// nothing to think about
+	if (mainThread->total_moves == 1)
+		return mainThread->moves[0];
+
+	for (int t = 0; t < searchConfig.threads; t++) {
+		SearchThread *thread = &threadState[t];
+
+		if (t > 0) {
+			thread->position = mainThread->position;
+			thread->patterns = mainThread->patterns;
+			thread->total_moves = mainThread->total_moves;
+
+			// every helper starts from a differently rotated root move list
+			for (int i = 0; i < thread->total_moves; i++)
+				thread->moves[i] = mainThread->moves[(i + t) % thread->total_moves];
+		}
+
+		thread->id = t;
+		thread->undoStack.top = 0;
+		thread->nodes = 0;
+#ifdef SEARCH_STATS
+		thread->leafEvaluations = thread->ttProbes = thread->ttHits = thread->ttCutoffs = 0;
+		memset(thread->cutoffIndex, 0, sizeof(thread->cutoffIndex));
+#endif
+		thread->bestMove = thread->moves[0];
+		thread->completedDepth = 0;
+
+		// ordering statistics start over with every move
+		memset(thread->killers, -1, sizeof(thread->killers));
+		memset(thread->history, 0, sizeof(thread->history));
+	}
+
+	// few empty cells left: play perfectly instead of searching to a depth
+	int empty_cells = bbPopCount(bbEmptyCells(&mainThread->position));
+	if (empty_cells <= searchConfig.endgameEmpties) {
+		bestMove = solveEndgameRoot(mainThread);
+
+		SEARCH_STAT(addSearchStats(mainThread));
+		searchInfo.nodes = mainThread->nodes;
+		searchInfo.depth = empty_cells;
+		searchInfo.score = mainThread->bestScore;
+		searchInfo.time = elapsedTime();
+		return bestMove;
+	}
+
+	// Lazy SMP: helpers search the same root and only talk through the transposition table
+	for (int t = 1; t < searchConfig.threads; t++)
+		pthread_create(&helpers[t], NULL, iterativeDeepening, &threadState[t]);
+
+	iterativeDeepening(mainThread);
+
+	for (int t = 1; t < searchConfig.threads; t++)
+		pthread_join(helpers[t], NULL);
+
+	// play the move of the deepest completed iteration (the main thread's on ties)
+	SearchThread *deepest = mainThread;
+	for (int t = 1; t < searchConfig.threads; t++)
+		if (threadState[t].completedDepth > deepest->completedDepth)
+			deepest = &threadState[t];
+
+	for (int t = 0; t < searchConfig.threads; t++) {
+		searchInfo.nodes += threadState[t].nodes;
+		SEARCH_STAT(addSearchStats(&threadState[t]));
+	}
+	searchInfo.depth = deepest->completedDepth;
+	searchInfo.score = deepest->bestScore;
+	searchInfo.time = elapsedTime();
+
+    return deepest->bestMove;
+}
+
+// --- Select Best Move (iterative deepening until the time budget runs out) ---
+Move getBestMove(Position *gamePosition, char color) {
+	clock_gettime(CLOCK_MONOTONIC, &searchStart);
+	searchDeadline = searchConfig.moveTime;
+	searchAborted = FALSE;
+
+	return searchPosition(gamePosition, color);
+}
+
+
+/* Pondering */
+
+void *ponderSearch(void *argument) {
+	ponderMove = searchPosition(&ponderPosition, ponderColor);
+	return NULL;
+}
+
+// --- Guess the opponent's reply from the table and search behind it, with no deadline ---
+void startPondering(Position *gamePosition, char color) {
+	BitPosition position;
+	TTData stored;
+	char opponent = getOtherSide(color);
+
+	stopPondering();
+
+	positionToBitPosition(gamePosition, &position);
+	ponderPrediction.color = opponent;
+
+	// our last search stored the reply it expected, unless the opponent has to pass
+	if (!canBitMove(&position, opponent)) {
+		if (!canBitMove(&position, color))
+			return;
+		ponderPrediction.tile[0] = NULL_MOVE;
+	} else if (probeTransposition(position.hash, &stored) && stored.move != TT_NO_MOVE && bbTestBit(generateMoves(&position, opponent), fromCanonicalCell(&position, stored.move))) {
+		ponderPrediction.tile[0] = BIT_ROW(fromCanonicalCell(&position, stored.move));
+		ponderPrediction.tile[1] = BIT_COL(fromCanonicalCell(&position, stored.move));
+	} else
+		return;
+
+	ponderPosition = *gamePosition;
+	doMove(&ponderPosition, &ponderPrediction);
+	ponderColor = color;
+
+	// set before the thread starts, so that a quick ponderHit() or stopPondering() is never undone
+	clock_gettime(CLOCK_MONOTONIC, &searchStart);
+	searchDeadline = 0;
+	searchAborted = FALSE;
+
+	ponderRunning = pthread_create(&ponderThread, NULL, ponderSearch, NULL) == 0;
+}
+
+// --- The opponent moved: keep the search if it was the predicted move, abort it otherwise ---
+int ponderHit(Move *opponentMove) {
+	if (!ponderRunning)
+		return FALSE;
+
+	if (opponentMove->tile[0] == ponderPrediction.tile[0] && (opponentMove->tile[0] == NULL_MOVE || opponentMove->tile[1] == ponderPrediction.tile[1])) {
+		// the time pondered so far is a bonus on top of the normal budget
+		if (searchConfig.moveTime > 0)
+			searchDeadline = elapsedTime() + searchConfig.moveTime;
+		return TRUE;
+	}
+
+	stopPondering();
+	return FALSE;
+}
+
+// --- Wait for the search ponderHit() kept going ---
+Move finishPondering(void) {
+	pthread_join(ponderThread, NULL);
+	ponderRunning = FALSE;
+
+	return ponderMove;
+}
+
+// --- Abort the ponder search, what it stored in the table stays ---
+void stopPondering(void) {
+	if (!ponderRunning)
+		return;
+
+	searchAborted = TRUE;
+	pthread_join(ponderThread, NULL);
+	ponderRunning = FALSE;
+}
+
+
+// --- Prepare the search (once, after initBoardTables() and initPatterns()) ---
+void initSearch(void) {
+	initEvaluation();
+}
+
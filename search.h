@@ -0,0 +1,90 @@
+#ifndef _SEARCH_H
+#define _SEARCH_H
+
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "pattern.h"
+
+/**********************************************************/
+// iterative deepening stops here even if there is time left
+#define MAX_SEARCH_DEPTH 64
+
+// default thinking time per move (milliseconds)
+#define DEFAULT_MOVE_TIME 1000
+
+// upper limit for the number of search threads
+#define MAX_THREADS 64
+
+// the exact endgame solver takes over at the root from this many empty cells
+#define DEFAULT_ENDGAME_EMPTIES 12
+
+// search algorithms
+#define SEARCH_PVS 0
+#define SEARCH_MINIMAX 1
+
+// build with -DSEARCH_STATS (make STATS=1) to count what the search does, otherwise the counters compile to nothing
+#ifdef SEARCH_STATS
+	#define SEARCH_STAT( statement ) statement
+#else
+	#define SEARCH_STAT( statement )
+#endif
+
+// beta cutoffs are counted by the index of the move that caused them, the last bin takes all later moves
+#define CUTOFF_INDEX_BINS 8
+
+/**********************************************************/
+/* How getBestMove() searches (filled from the command line by the programs that use it) */
+typedef struct
+{
+	int moveTime;							// time budget per move (ms), 0 for no limit
+	int maxDepth;							// iterative deepening stops at this depth
+	int threads;							// threads searching each move (Lazy SMP), 1 is deterministic
+	int endgameEmpties;						// solve exactly at or below this many empty cells
+	int algorithm;							// SEARCH_PVS, or the old max/min minimax for A/B tests
+} SearchConfig;
+
+/* What the last getBestMove() did */
+typedef struct
+{
+	long long nodes;						// all threads together
+	int depth;								// deepest completed iteration (empty cells for an endgame solve)
+	int score;								// score of the chosen move at that depth
+	long time;								// ms
+	long depthTime[ MAX_SEARCH_DEPTH + 1 ];	// ms at which the main thread completed each depth
+#ifdef SEARCH_STATS
+	long long leafEvaluations;				// calls of the evaluation
+	long long ttProbes;						// transposition table lookups
+	long long ttHits;						// ... that found the position
+	long long ttCutoffs;					// ... whose stored bound ended the node
+	long long cutoffIndex[ CUTOFF_INDEX_BINS ];	// beta cutoffs by the index of the move that caused them
+#endif
+} SearchInfo;
+
+/**********************************************************/
+extern SearchConfig searchConfig;
+extern SearchInfo searchInfo;
+
+/**********************************************************/
+void initSearch( void );
+//builds the evaluation tables (needs initBoardTables() and initPatterns())
+
+void computeEvaluationFeatures( BitPosition * pos, char color, int features[ EVALUATION_FEATURES ] );
+//the features evaluatePosition() weighs, from color's point of view (needs initSearch())
+
+Move getBestMove( Position * gamePosition, char color );
+//searches the position for color and returns the move to play (a null move if there is none)
+
+void startPondering( Position * gamePosition, char color );
+//gamePosition is after our move: searches for color behind the opponent's expected reply in a background thread (no-op if the table has no guess)
+
+int ponderHit( Move * opponentMove );
+//TRUE if the opponent played the expected reply, the search then goes on with searchConfig.moveTime from now; otherwise it is aborted
+
+Move finishPondering( void );
+//waits for the search after a ponder hit and returns its move
+
+void stopPondering( void );
+//aborts a running ponder search (the transposition table keeps what it found)
+
+#endif
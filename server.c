@@ -7,8 +7,101 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
 
 
+/**********************************************************/
+Reactor reactor;
+Connection connections[ 2 ];		// of playerOne and playerTwo
+
+int moveClock = 0;					// ms a player is told it has for a move (-c), 0 for no limit
+
+/**********************************************************/
+Connection * connectionOf( PlayerStruct * player )
+{
+	return &connections[ player == &playerTwo ? 1 : 0 ];
+}
+
+/**********************************************************/
+// runs the reactor until a whole frame of that type has arrived from player, returns its length or -1 if the player is gone
+// (a frame whose payload doesn't fit its code drops the player)
+int waitForFrame( PlayerStruct * player, int frameType )
+{
+	Connection * conn = connectionOf( player );
+	ReactorEvent events[ MAX_REACTOR_EVENTS ];
+	int i, n, length;
+
+	//everything queued since the last wait leaves now, one send per player
+	for( i = 0; i < 2; i++ )
+		if( connections[ i ].socket >= 0 && connectionFlush( &connections[ i ] ) < 0 )
+			closeConnection( &connections[ i ] );
+
+	while( ( length = connectionFrame( conn, frameType ) ) == 0 )
+	{
+		if( conn->socket < 0 )
+			return -1;
+
+		n = reactorWait( &reactor, events, -1 );
+
+		//the other player's input waits in its buffer, its output keeps flowing
+		for( i = 0; i < n; i++ )
+		{
+			Connection * ready = connectionOf( events[ i ].owner );
+
+			//a peer that closed is dropped, unless what it sent last is the frame we wait for
+			if( events[ i ].readable && connectionRead( ready ) < 0 && !( ready == conn && connectionFrame( conn, frameType ) > 0 ) )
+				closeConnection( ready );
+			if( events[ i ].writable && connectionFlush( ready ) < 0 )
+				closeConnection( ready );
+		}
+	}
+
+	if( !frameFits( conn, frameType, length ) )
+	{
+		printf( "Player: %s sent a malformed message\n", player->name );
+		closeConnection( conn );
+		return -1;
+	}
+
+	return length;
+}
+
+/**********************************************************/
+int getMoveFrom( PlayerStruct * player, Move * moveToGet )
+{
+	Connection * conn = connectionOf( player );
+	int length;
+
+	//a v2 player whose position went wrong sends it instead of a move: it gets what differs and a new request
+	while( ( length = waitForFrame( player, FRAME_MOVE ) ) >= 0 && frameCode( conn ) == NM_RESYNC )
+	{
+		printf( "Player: %s asked for a resync\n", player->name );
+		queueResync( conn, connectionPayload( conn ), &gamePosition );
+		connectionConsume( conn, length );
+		queueMoveRequest( conn, NULL, &gamePosition, moveClock );
+	}
+
+	if( length < 0 )
+		return -1;
+
+	frameToMove( connectionPayload( connectionOf( player ) ), moveToGet );
+	connectionConsume( connectionOf( player ), length );
+	return 0;
+}
+
+/**********************************************************/
+int getNameFrom( PlayerStruct * player )
+{
+	int length = waitForFrame( player, FRAME_NAME );
+
+	if( length < 0 )
+		return -1;
+
+	frameToName( connectionPayload( connectionOf( player ) ), player->name );
+	connectionConsume( connectionOf( player ), length );
+	return 0;
+}
+
 /**********************************************************/
 int main( int argc, char **argv )
 {
@@ -18,11 +111,11 @@ int main( int argc, char **argv )
 	int c;
 	opterr = 0;
 
-	while( ( c = getopt( argc, argv, "p:g:hs" ) ) != -1 )
+	while( ( c = getopt( argc, argv, "p:g:c:hs" ) ) != -1 )
 		switch( c )
 		{
 			case 'h':
-				printf( "[-p port] [-g number_of_games] [-s (swap color after each game)]\n" );
+				printf( "[-p port] [-g number_of_games] [-s (swap color after each game)] [-c move_clock_ms]\n" );
 				return 0;
 			case 'p':
 				port = optarg;
@@ -33,8 +126,11 @@ int main( int argc, char **argv )
 			case 's':
 				swapAfterEachGame = TRUE;
 				break;
+			case 'c':
+				moveClock = atoi( optarg );
+				break;
 			case '?':
-				if( optopt == 'p' || optopt == 'g' )
+				if( optopt == 'p' || optopt == 'g' || optopt == 'c' )
 					printf( "Option -%c requires an argument.\n", ( char ) optopt );
 				else if( isprint( optopt ) )
 					printf( "Unknown option -%c\n", ( char ) optopt );
@@ -47,41 +143,56 @@ int main( int argc, char **argv )
 
 
 
+	initBoardTables();
+
 	listenToSocket( port, &serverSocket );
 
+	if( initReactor( &reactor ) < 0 )
+		return 1;
+
 	playerOne.playerSocket = acceptConnection( serverSocket );
+	initConnection( &connections[ 0 ], playerOne.playerSocket, &playerOne );
+	reactorAddConnection( &reactor, &connections[ 0 ] );
+
 	playerTwo.playerSocket = acceptConnection( serverSocket );
+	initConnection( &connections[ 1 ], playerTwo.playerSocket, &playerTwo );
+	reactorAddConnection( &reactor, &connections[ 1 ] );
 
-	//first who connects gets white color
-	playerOne.color = WHITE;
-	playerTwo.color = BLACK;
+	//request names, offering v2 first: the answer to the request tells which protocol the player speaks
+	strcpy( playerOne.name, "?" );
+	strcpy( playerTwo.name, "?" );
+
+	queueOffer( &connections[ 0 ] );
+	queueMsg( &connections[ 0 ], NM_REQUEST_NAME );
+	getNameFrom( &playerOne );
 
-	sendMsg( NM_COLOR_W, playerOne.playerSocket );
-	sendMsg( NM_COLOR_B, playerTwo.playerSocket );
+	queueOffer( &connections[ 1 ] );
+	queueMsg( &connections[ 1 ], NM_REQUEST_NAME );
+	getNameFrom( &playerTwo );
 
 
-	//request names
-	sendMsg( NM_REQUEST_NAME, playerOne.playerSocket );
-	getName( playerOne.name, playerOne.playerSocket );
+	//first who connects gets white color
+	playerOne.color = WHITE;
+	playerTwo.color = BLACK;
 
-	sendMsg( NM_REQUEST_NAME, playerTwo.playerSocket );
-	getName( playerTwo.name, playerTwo.playerSocket );
+	queueMsg( &connections[ 0 ], NM_COLOR_W );
+	queueMsg( &connections[ 1 ], NM_COLOR_B );
 
 
 	int i;
+	int moveToForward;		//the player to move has not been sent the last move yet
 
-	for( i = 0; i < numberOfGames; i++ )
+	for( i = 0; i < numberOfGames && connections[ 0 ].socket >= 0 && connections[ 1 ].socket >= 0; i++ )
 	{
 
 		initPosition( &gamePosition );
 		printPosition( &gamePosition );
 
 		//sending position
-		sendMsg( NM_NEW_POSITION, playerOne.playerSocket );
-		sendPosition( &gamePosition, playerOne.playerSocket );
+		queuePosition( &connections[ 0 ], &gamePosition );
+		queuePosition( &connections[ 1 ], &gamePosition );
 
-		sendMsg( NM_NEW_POSITION, playerTwo.playerSocket );
-		sendPosition( &gamePosition, playerTwo.playerSocket );
+		moveToForward = FALSE;
 
 		while( 1 )		//inside a game
 		{
@@ -97,9 +208,12 @@ int main( int argc, char **argv )
 				waitingPlayer = &playerOne;
 			}
 
-			//get move
-			sendMsg( NM_REQUEST_MOVE, playingPlayer->playerSocket );
-			getMove( &tempMove, playingPlayer->playerSocket );
+			//get move, the opponent's last move goes along with the request
+			if( queueMoveRequest( connectionOf( playingPlayer ), moveToForward ? &tempMove : NULL, &gamePosition, moveClock ) < 0 || getMoveFrom( playingPlayer, &tempMove ) < 0 )		//technical loss
+			{
+				printf( "Player: %s disconnected and lost the game!\n", playingPlayer->name );
+				break;
+			}
 
 			tempMove.color = playingPlayer->color;
 
@@ -169,9 +283,8 @@ int main( int argc, char **argv )
 				break;
 			}
 
-			//send move to the other player
-			sendMsg( NM_PREPARE_TO_RECEIVE_MOVE, waitingPlayer->playerSocket );
-			sendMove( &tempMove, waitingPlayer->playerSocket );
+			//the other player moves next (passes are null moves), it gets the move with its request
+			moveToForward = TRUE;
 
 
 		}
@@ -180,15 +293,15 @@ int main( int argc, char **argv )
 		{
 			if( playerOne.color == BLACK )
 			{
-				sendMsg( NM_COLOR_W, playerOne.playerSocket );
-				sendMsg( NM_COLOR_B, playerTwo.playerSocket );
+				queueMsg( &connections[ 0 ], NM_COLOR_W );
+				queueMsg( &connections[ 1 ], NM_COLOR_B );
 				playerOne.color = WHITE;
 				playerTwo.color = BLACK;
 			}
 			else
 			{
-				sendMsg( NM_COLOR_B, playerOne.playerSocket );
-				sendMsg( NM_COLOR_W, playerTwo.playerSocket );
+				queueMsg( &connections[ 0 ], NM_COLOR_B );
+				queueMsg( &connections[ 1 ], NM_COLOR_W );
 				playerOne.color = BLACK;
 				playerTwo.color = WHITE;
 			}
@@ -197,8 +310,15 @@ int main( int argc, char **argv )
 
 	}
 
-	sendMsg( NM_QUIT, playerOne.playerSocket );
-	sendMsg( NM_QUIT, playerTwo.playerSocket );
+	//blocking again so that everything still queued gets out
+	for( i = 0; i < 2; i++ )
+		if( connections[ i ].socket >= 0 )
+		{
+			fcntl( connections[ i ].socket, F_SETFL, fcntl( connections[ i ].socket, F_GETFL, 0 ) & ~O_NONBLOCK );
+			queueMsg( &connections[ i ], NM_QUIT );
+			connectionFlush( &connections[ i ] );
+			closeConnection( &connections[ i ] );
+		}
 
 	return 0;
 }
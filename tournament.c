@@ -0,0 +1,682 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "comm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <fcntl.h>
+
+
+/**********************************************************/
+#define MAX_PLAYERS 256
+
+#define DEFAULT_PLAYERS 2
+
+// games of every pairing, colors alternate
+#define DEFAULT_GAMES_PER_PAIRING 2
+
+#define FORMAT_ROUND_ROBIN 0
+#define FORMAT_SWISS 1
+
+// what a player is expected to send next
+#define EXPECT_NOTHING 0
+#define EXPECT_NAME 1
+#define EXPECT_MOVE 2
+#define EXPECT_STALE_MOVE 3			// asked for a move in a game that has ended meanwhile, the answer is dropped
+
+#define GAME_PENDING 0
+#define GAME_RUNNING 1
+#define GAME_FINISHED 2
+/**********************************************************/
+
+/* A connected engine */
+typedef struct
+{
+	Connection connection;				// socket -1 once disconnected
+	char name[ MAX_NAME_LENGTH + 1 ];
+	int expecting;
+
+	int game;							// game being played, -1 when idle
+	int halfPoints;						// win 2, draw 1, loss 0
+	int wins, draws, losses;
+	int hadBye;
+} Player;
+
+/* State of one game, everything server.c keeps in globals */
+typedef struct
+{
+	int player[ 2 ];					// indices of the WHITE and the BLACK player
+	int state;
+	int round;
+	Position position;
+} Game;
+
+Player players[ MAX_PLAYERS ];
+int numberOfPlayers = DEFAULT_PLAYERS;
+int connectedPlayers = 0;
+int namedPlayers = 0;
+
+Game * games = NULL;
+int totalGames = 0;					// games scheduled so far
+int finishedGames = 0;
+
+int gamesPerPairing = DEFAULT_GAMES_PER_PAIRING;
+int format = FORMAT_ROUND_ROBIN;
+int swissRounds = 0;				// 0: enough rounds to separate the players (log2)
+int currentRound = 0;
+
+int moveClock = 0;					// ms a player is told it has for a move (-c), 0 for no limit
+
+int serverSocket;
+Reactor reactor;
+/**********************************************************/
+
+
+void disconnectPlayer( int p );
+
+// --- Queue messages for a player, one that failed or stopped reading (full buffer) is dropped ---
+void sendToPlayer( int p, int msg )
+{
+	if( queueMsg( &players[ p ].connection, msg ) < 0 )
+		disconnectPlayer( p );
+}
+
+void sendMoveRequestToPlayer( int p, Move * opponentMove )
+{
+	if( queueMoveRequest( &players[ p ].connection, opponentMove, &games[ players[ p ].game ].position, moveClock ) < 0 )
+		disconnectPlayer( p );
+}
+
+void sendPositionToPlayer( int p, Position * posToSend )
+{
+	if( queuePosition( &players[ p ].connection, posToSend ) < 0 )
+		disconnectPlayer( p );
+}
+
+/**********************************************************/
+
+// --- Record the result of a game and free both players ---
+void finishGame( int g, int forfeitColor )
+{
+	Game * game = &games[ g ];
+	int diff, c;
+
+	// a technical loss counts as a loss whatever the discs say
+	if( forfeitColor == WHITE )
+		diff = -1;
+	else if( forfeitColor == BLACK )
+		diff = 1;
+	else
+		diff = game->position.score[ WHITE ] - game->position.score[ BLACK ];
+
+	for( c = WHITE; c <= BLACK; c++ )
+	{
+		Player * player = &players[ game->player[ c ] ];
+		int my_diff = ( c == WHITE ) ? diff : -diff;
+
+		if( my_diff > 0 )
+		{
+			player->wins++;
+			player->halfPoints += 2;
+		}
+		else if( my_diff == 0 )
+		{
+			player->draws++;
+			player->halfPoints += 1;
+		}
+		else
+			player->losses++;
+
+		// a game that never started leaves the player's current one alone
+		if( player->game == g )
+		{
+			player->game = -1;
+			if( player->expecting == EXPECT_MOVE )
+				player->expecting = EXPECT_STALE_MOVE;
+		}
+	}
+
+	printf( "Game %d (round %d): %s (W) vs %s (B): ", g + 1, game->round, players[ game->player[ WHITE ] ].name, players[ game->player[ BLACK ] ].name );
+	if( forfeitColor != EMPTY )
+		printf( "%s lost by forfeit\n", forfeitColor == WHITE ? "WHITE" : "BLACK" );
+	else if( diff > 0 )
+		printf( "WHITE WON! Score W:%d B:%d\n", game->position.score[ WHITE ], game->position.score[ BLACK ] );
+	else if( diff < 0 )
+		printf( "BLACK WON! Score W:%d B:%d\n", game->position.score[ WHITE ], game->position.score[ BLACK ] );
+	else
+		printf( "DRAW! Score W:%d B:%d\n", game->position.score[ WHITE ], game->position.score[ BLACK ] );
+
+	game->state = GAME_FINISHED;
+	finishedGames++;
+}
+
+// --- A player left: its running and future games are lost ---
+void disconnectPlayer( int p )
+{
+	Player * player = &players[ p ];
+	int g;
+
+	if( player->connection.socket < 0 )
+		return;
+
+	printf( "Player: %s disconnected\n", player->name );
+	player->expecting = EXPECT_NOTHING;
+
+	closeConnection( &player->connection );
+	connectedPlayers--;
+
+	// before the schedule is made the slot is simply given to the next connection
+	if( games == NULL )
+	{
+		if( player->name[ 0 ] != '?' )
+			namedPlayers--;
+		player->name[ 0 ] = '\0';
+		return;
+	}
+
+	for( g = 0; g < totalGames; g++ )
+		if( games[ g ].state != GAME_FINISHED && ( games[ g ].player[ WHITE ] == p || games[ g ].player[ BLACK ] == p ) )
+			finishGame( g, games[ g ].player[ WHITE ] == p ? WHITE : BLACK );
+}
+
+/**********************************************************/
+
+// --- Ask the player on turn for a move, with the opponent's last move unless the game just started ---
+void requestMove( int g, Move * opponentMove )
+{
+	Game * game = &games[ g ];
+	int p = game->player[ ( int ) game->position.turn ];
+
+	players[ p ].expecting = EXPECT_MOVE;
+	sendMoveRequestToPlayer( p, opponentMove );
+}
+
+// --- Send colors and the starting position, then ask the side to move (BLACK) for a move ---
+void startGame( int g )
+{
+	Game * game = &games[ g ];
+
+	game->state = GAME_RUNNING;
+	initPosition( &game->position );
+
+	players[ game->player[ WHITE ] ].game = g;
+	players[ game->player[ BLACK ] ].game = g;
+
+	sendToPlayer( game->player[ WHITE ], NM_COLOR_W );
+	sendToPlayer( game->player[ BLACK ], NM_COLOR_B );
+
+	sendPositionToPlayer( game->player[ WHITE ], &game->position );
+	sendPositionToPlayer( game->player[ BLACK ], &game->position );
+
+	// one of them may have been lost while sending
+	if( game->state == GAME_RUNNING )
+		requestMove( g, NULL );
+}
+
+// --- Same legality and victory checks as server.c, for one game ---
+void moveReceived( int p, Move * move )
+{
+	int g = players[ p ].game;
+	Game * game = &games[ g ];
+	char color = game->position.turn;
+
+	players[ p ].expecting = EXPECT_NOTHING;
+	move->color = color;
+
+	if( !canMove( &game->position, color ) )
+	{
+		if( move->tile[ 0 ] != NULL_MOVE )
+		{
+			printf( "Player: %s tried an illegal move and lost the game! Illegal move: ( %d, %d )\n", players[ p ].name, move->tile[ 0 ], move->tile[ 1 ] );
+			finishGame( g, color );
+			return;
+		}
+	}
+	else if( !isLegalMove( &game->position, move ) )
+	{
+		if( move->tile[ 0 ] == NULL_MOVE )
+			printf( "Player: %s tried an illegal move and lost the game! Illegal move: NULL MOVE\n", players[ p ].name );
+		else
+			printf( "Player: %s tried an illegal move and lost the game! Illegal move: ( %d, %d )\n", players[ p ].name, move->tile[ 0 ], move->tile[ 1 ] );
+		finishGame( g, color );
+		return;
+	}
+
+	doMove( &game->position, move );
+
+	if( !canMove( &game->position, WHITE ) && !canMove( &game->position, BLACK ) )
+	{
+		finishGame( g, EMPTY );
+		return;
+	}
+
+	// passes are null moves, so the player who just waited is the one on turn
+	requestMove( g, move );
+}
+
+// --- Use every complete message in a player's input buffer ---
+void parseInput( int p )
+{
+	Player * player = &players[ p ];
+	Connection * conn = &player->connection;
+	int length;
+
+	while( conn->socket >= 0 && conn->inputLength > 0 )
+	{
+		if( player->expecting == EXPECT_NAME )
+		{
+			if( ( length = connectionFrame( conn, FRAME_NAME ) ) == 0 )
+				return;
+			if( !frameFits( conn, FRAME_NAME, length ) )
+				break;
+
+			frameToName( connectionPayload( conn ), player->name );
+			connectionConsume( conn, length );
+
+			player->expecting = EXPECT_NOTHING;
+			namedPlayers++;
+			printf( "Player %d: %s\n", p + 1, player->name );
+		}
+		else if( player->expecting == EXPECT_STALE_MOVE )
+		{
+			if( ( length = connectionFrame( conn, FRAME_MOVE ) ) == 0 )
+				return;
+			if( !frameFits( conn, FRAME_MOVE, length ) )
+				break;
+
+			connectionConsume( conn, length );
+			player->expecting = EXPECT_NOTHING;
+		}
+		else if( player->expecting == EXPECT_MOVE )
+		{
+			Move move;
+
+			if( ( length = connectionFrame( conn, FRAME_MOVE ) ) == 0 )
+				return;
+			if( !frameFits( conn, FRAME_MOVE, length ) )
+				break;
+
+			// a v2 player whose position went wrong: what differs and the request again
+			if( frameCode( conn ) == NM_RESYNC )
+			{
+				printf( "Player: %s asked for a resync\n", player->name );
+				if( queueResync( conn, connectionPayload( conn ), &games[ player->game ].position ) < 0 )
+				{
+					disconnectPlayer( p );
+					return;
+				}
+				connectionConsume( conn, length );
+				requestMove( player->game, NULL );
+				continue;
+			}
+
+			frameToMove( connectionPayload( conn ), &move );
+			connectionConsume( conn, length );
+			moveReceived( p, &move );
+		}
+		else
+		{
+			printf( "Player: %s sent data out of turn\n", player->name );
+			disconnectPlayer( p );
+			return;
+		}
+	}
+
+	// left the loop on a frame whose payload doesn't fit its code
+	if( conn->socket >= 0 && conn->inputLength > 0 )
+	{
+		printf( "Player: %s sent a malformed message\n", player->name );
+		disconnectPlayer( p );
+	}
+}
+
+// --- Read whatever arrived, partial messages wait in the buffer ---
+void readPlayer( int p )
+{
+	// a client may send its last move and quit, use what arrived before dropping it
+	int result = connectionRead( &players[ p ].connection );
+
+	parseInput( p );
+
+	if( result < 0 )
+		disconnectPlayer( p );
+}
+
+// --- New connection: a player slot until the field is full ---
+void acceptPlayer( void )
+{
+	int socket, p;
+
+	while( ( socket = accept( serverSocket, NULL, NULL ) ) >= 0 )
+	{
+		// the first free slot: a slot is only reused if its player left before the schedule was made
+		for( p = 0; p < numberOfPlayers && ( players[ p ].connection.socket >= 0 || players[ p ].name[ 0 ] != '\0' ); p++ )
+			;
+
+		if( p == numberOfPlayers )
+		{
+			close( socket );
+			continue;
+		}
+
+		initConnection( &players[ p ].connection, socket, &players[ p ] );
+		reactorAddConnection( &reactor, &players[ p ].connection );
+
+		players[ p ].game = -1;
+		strcpy( players[ p ].name, "?" );
+		connectedPlayers++;
+
+		// the reply to the name request tells whether the player took the v2 offer
+		players[ p ].expecting = EXPECT_NAME;
+		if( queueOffer( &players[ p ].connection ) < 0 )
+			disconnectPlayer( p );
+		else
+			sendToPlayer( p, NM_REQUEST_NAME );
+	}
+}
+
+/**********************************************************/
+
+// --- Append a game to the schedule ---
+void addGame( int white, int black, int round )
+{
+	games[ totalGames ].player[ WHITE ] = white;
+	games[ totalGames ].player[ BLACK ] = black;
+	games[ totalGames ].state = GAME_PENDING;
+	games[ totalGames ].round = round;
+	totalGames++;
+}
+
+// --- Round robin: circle method, every round pairs everybody once, the pairing's games swap colors ---
+void scheduleRoundRobin( void )
+{
+	int slots = numberOfPlayers + ( numberOfPlayers % 2 );		// odd fields get a dummy slot (a bye)
+	int circle[ MAX_PLAYERS + 1 ];
+	int round, i, k;
+
+	games = malloc( ( size_t ) slots / 2 * ( slots - 1 ) * gamesPerPairing * sizeof( Game ) );
+
+	for( i = 0; i < slots; i++ )
+		circle[ i ] = i;
+
+	for( round = 0; round < slots - 1; round++ )
+	{
+		for( i = 0; i < slots / 2; i++ )
+		{
+			int a = circle[ i ], b = circle[ slots - 1 - i ];
+
+			if( a >= numberOfPlayers || b >= numberOfPlayers )
+				continue;
+
+			for( k = 0; k < gamesPerPairing; k++ )
+				if( ( k + round ) % 2 == 0 )
+					addGame( a, b, round + 1 );
+				else
+					addGame( b, a, round + 1 );
+		}
+
+		// keep circle[0] fixed and rotate the rest
+		int last = circle[ slots - 1 ];
+		for( i = slots - 1; i > 1; i-- )
+			circle[ i ] = circle[ i - 1 ];
+		circle[ 1 ] = last;
+	}
+}
+
+// --- Has a met b in an earlier round? ---
+int havePlayed( int a, int b )
+{
+	for( int g = 0; g < totalGames; g++ )
+		if( ( games[ g ].player[ WHITE ] == a && games[ g ].player[ BLACK ] == b ) || ( games[ g ].player[ WHITE ] == b && games[ g ].player[ BLACK ] == a ) )
+			return TRUE;
+	return FALSE;
+}
+
+// --- Swiss: pair neighbours in the standings, avoiding rematches where possible ---
+void scheduleSwissRound( void )
+{
+	int order[ MAX_PLAYERS ], paired[ MAX_PLAYERS ];
+	int i, j, k, count = 0;
+
+	currentRound++;
+
+	for( i = 0; i < numberOfPlayers; i++ )
+		if( players[ i ].connection.socket >= 0 )
+		{
+			order[ count++ ] = i;
+			paired[ i ] = FALSE;
+		}
+
+	// standings, stable on ties
+	for( i = 1; i < count; i++ )
+	{
+		int p = order[ i ];
+		for( j = i; j > 0 && players[ order[ j - 1 ] ].halfPoints < players[ p ].halfPoints; j-- )
+			order[ j ] = order[ j - 1 ];
+		order[ j ] = p;
+	}
+
+	// an odd field: the lowest ranked player without a bye sits out and gets a win
+	// (once everybody has had one, the lowest ranked player again)
+	if( count % 2 == 1 )
+	{
+		for( i = count - 1; i >= 0 && players[ order[ i ] ].hadBye; i-- )
+			;
+		if( i < 0 )
+			i = count - 1;
+		players[ order[ i ] ].hadBye = TRUE;
+		players[ order[ i ] ].halfPoints += 2;
+		players[ order[ i ] ].wins++;
+		paired[ order[ i ] ] = TRUE;
+		printf( "Round %d: %s has a bye\n", currentRound, players[ order[ i ] ].name );
+	}
+
+	for( i = 0; i < count; i++ )
+	{
+		int a = order[ i ], b = -1;
+
+		if( paired[ a ] )
+			continue;
+
+		for( j = i + 1; j < count; j++ )
+			if( !paired[ order[ j ] ] && !havePlayed( a, order[ j ] ) )
+			{
+				b = order[ j ];
+				break;
+			}
+
+		// everybody left has been met already
+		for( j = i + 1; b < 0 && j < count; j++ )
+			if( !paired[ order[ j ] ] )
+				b = order[ j ];
+
+		if( b < 0 )
+			break;
+
+		paired[ a ] = paired[ b ] = TRUE;
+		for( k = 0; k < gamesPerPairing; k++ )
+			if( ( k + currentRound ) % 2 == 0 )
+				addGame( a, b, currentRound );
+			else
+				addGame( b, a, currentRound );
+	}
+}
+
+// --- Not playing and not still answering an ended game ---
+int isFree( int p )
+{
+	return players[ p ].game < 0 && players[ p ].expecting == EXPECT_NOTHING;
+}
+
+// --- Start every pending game whose players are both free ---
+void startGames( void )
+{
+	for( int g = 0; g < totalGames; g++ )
+		if( games[ g ].state == GAME_PENDING && isFree( games[ g ].player[ WHITE ] ) && isFree( games[ g ].player[ BLACK ] ) )
+			startGame( g );
+}
+
+// --- Final standings ---
+void printStandings( void )
+{
+	int order[ MAX_PLAYERS ];
+	int i, j;
+
+	for( i = 0; i < numberOfPlayers; i++ )
+	{
+		for( j = i; j > 0 && players[ order[ j - 1 ] ].halfPoints < players[ i ].halfPoints; j-- )
+			order[ j ] = order[ j - 1 ];
+		order[ j ] = i;
+	}
+
+	printf( "\n  #  name       points    +    =    -\n" );
+	for( i = 0; i < numberOfPlayers; i++ )
+	{
+		Player * player = &players[ order[ i ] ];
+		printf( "%3d  %-8s  %7.1f  %3d  %3d  %3d\n", i + 1, player->name, player->halfPoints / 2.0, player->wins, player->draws, player->losses );
+	}
+}
+
+/**********************************************************/
+int main( int argc, char **argv )
+{
+	ReactorEvent events[ MAX_REACTOR_EVENTS ];
+	int c, i, n;
+	opterr = 0;
+
+	while( ( c = getopt( argc, argv, "p:n:g:f:r:c:h" ) ) != -1 )
+		switch( c )
+		{
+			case 'h':
+				printf( "[-p port] [-n number_of_players] [-g games_per_pairing] [-f roundrobin|swiss] [-r swiss_rounds] [-c move_clock_ms]\n" );
+				return 0;
+			case 'p':
+				port = optarg;
+				break;
+			case 'n':
+				numberOfPlayers = atoi( optarg );
+				if( numberOfPlayers < 2 || numberOfPlayers > MAX_PLAYERS )
+				{
+					printf( "Players must be between 2 and %d\n", MAX_PLAYERS );
+					return 1;
+				}
+				break;
+			case 'g':
+				gamesPerPairing = atoi( optarg );
+				break;
+			case 'f':
+				if( strcmp( optarg, "roundrobin" ) == 0 )
+					format = FORMAT_ROUND_ROBIN;
+				else if( strcmp( optarg, "swiss" ) == 0 )
+					format = FORMAT_SWISS;
+				else
+				{
+					printf( "Unknown format %s (roundrobin or swiss)\n", optarg );
+					return 1;
+				}
+				break;
+			case 'r':
+				swissRounds = atoi( optarg );
+				break;
+			case 'c':
+				moveClock = atoi( optarg );
+				break;
+			case '?':
+				if( optopt == 'p' || optopt == 'n' || optopt == 'g' || optopt == 'f' || optopt == 'r' || optopt == 'c' )
+					printf( "Option -%c requires an argument.\n", ( char ) optopt );
+				else if( isprint( optopt ) )
+					printf( "Unknown option -%c\n", ( char ) optopt );
+				else
+					printf( "Unknown option character -%c\n", ( char ) optopt );
+				return 1;
+			default:
+			return 1;
+		}
+
+	if( format == FORMAT_SWISS && swissRounds == 0 )
+		for( swissRounds = 1; ( 1 << swissRounds ) < numberOfPlayers; swissRounds++ )
+			;
+
+	initBoardTables();
+
+	for( i = 0; i < MAX_PLAYERS; i++ )
+		players[ i ].connection.socket = -1;
+
+	listenToSocket( port, &serverSocket );
+
+	if( initReactor( &reactor ) < 0 )
+		return 1;
+	reactorAddListener( &reactor, serverSocket, NULL );		// players are never NULL
+
+	printf( "Waiting for %d players...\n", numberOfPlayers );
+
+	while( TRUE )
+	{
+		// what the last pass queued for a player leaves in one send
+		for( i = 0; i < numberOfPlayers; i++ )
+			if( players[ i ].connection.socket >= 0 && players[ i ].connection.outputLength > 0 && connectionFlush( &players[ i ].connection ) < 0 )
+				disconnectPlayer( i );
+
+		n = reactorWait( &reactor, events, -1 );
+
+		for( i = 0; i < n; i++ )
+		{
+			int p;
+
+			if( events[ i ].owner == NULL )
+			{
+				acceptPlayer();
+				continue;
+			}
+
+			p = ( Player * ) events[ i ].owner - players;
+
+			if( events[ i ].readable )
+				readPlayer( p );
+			if( events[ i ].writable && connectionFlush( &players[ p ].connection ) < 0 )
+				disconnectPlayer( p );
+		}
+
+		// everybody is here: make the schedule once
+		if( games == NULL && namedPlayers == numberOfPlayers )
+		{
+			if( format == FORMAT_ROUND_ROBIN )
+				scheduleRoundRobin();
+			else
+			{
+				games = malloc( ( size_t ) swissRounds * ( numberOfPlayers / 2 ) * gamesPerPairing * sizeof( Game ) );
+				scheduleSwissRound();
+			}
+
+			printf( "%d players, %s, %d games scheduled\n", numberOfPlayers, format == FORMAT_SWISS ? "swiss" : "round robin", totalGames );
+		}
+
+		if( games == NULL )
+			continue;
+
+		// next Swiss round once the current one is over
+		if( format == FORMAT_SWISS && finishedGames == totalGames && currentRound < swissRounds && connectedPlayers > 1 )
+			scheduleSwissRound();
+
+		startGames();
+
+		if( finishedGames == totalGames && ( format != FORMAT_SWISS || currentRound >= swissRounds || connectedPlayers < 2 ) )
+			break;
+	}
+
+	printStandings();
+
+	for( i = 0; i < numberOfPlayers; i++ )
+		if( players[ i ].connection.socket >= 0 )
+		{
+			// blocking again so that the last message gets out
+			fcntl( players[ i ].connection.socket, F_SETFL, fcntl( players[ i ].connection.socket, F_GETFL, 0 ) & ~O_NONBLOCK );
+			queueMsg( &players[ i ].connection, NM_QUIT );
+			connectionFlush( &players[ i ].connection );
+			closeConnection( &players[ i ].connection );
+		}
+
+	return 0;
+}
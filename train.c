@@ -0,0 +1,708 @@
+#include "global.h"
+#include "board.h"
+#include "move.h"
+#include "transposition.h"
+#include "pattern.h"
+#include "search.h"
+#include "batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+
+/**********************************************************/
+// random plies played from initPosition before the engine takes over (-r)
+#define DEFAULT_RANDOM_PLIES 8
+
+// fixed search depth of the self-play games (-d)
+#define DEFAULT_TRAIN_DEPTH 4
+
+// conjugate gradient iterations of the fit (-i)
+#define DEFAULT_ITERATIONS 50
+
+#define DEFAULT_TRAIN_TT_MEGABYTES 16
+
+#define DEFAULT_SAMPLES_FILE "train.samples"
+
+#define SAMPLE_FILE_MAGIC "HXSP"
+#define SAMPLE_FILE_VERSION 1
+
+// a game has at most a move or a pass per playable cell and side
+#define MAX_GAME_SAMPLES ( 2 * PLAYABLE_CELLS )
+
+// evaluation units per disc of the final result, the fitted weights are in these units
+#define LABEL_SCALE 16
+
+// ridge penalty of every weight's change (-l), rare pattern configurations stay close to the starting weights.
+// A pattern weight needs about this many occurrences before it moves halfway to its fit
+#define DEFAULT_REGULARIZATION 50000.0
+
+// every tenth game is kept out of the fit and only measured
+#define VALIDATION_GAMES 10
+
+// variables of the fit: the feature weights of every color and phase, then the pattern tables of every phase
+#define FEATURE_VARIABLES ( 2 * EVALUATION_PHASES * EVALUATION_FEATURES )
+#define VARIABLES ( FEATURE_VARIABLES + EVALUATION_PHASES * PATTERN_WEIGHTS )
+#define FEATURE_VARIABLE( color, phase, feature ) ( ( ( color ) * EVALUATION_PHASES + ( phase ) ) * EVALUATION_FEATURES + ( feature ) )
+#define PATTERN_VARIABLE( phase, weight ) ( FEATURE_VARIABLES + ( phase ) * PATTERN_WEIGHTS + ( weight ) )
+
+// max() macro
+#define max(a, b) ((a > b) ? a : b)
+/**********************************************************/
+
+/* A position of a self-play game, labelled with the result the game ended with */
+typedef struct
+{
+	Bitboard disc[ 2 ];
+	short result;							// WHITE's discs - BLACK's discs at the end of the game
+	char turn;
+	char endOfGame;							// TRUE on the last sample of a game
+	char reserved[ 4 ];
+} TrainingSample;
+
+/* A sample as the fit sees it: the inputs of evaluatePosition() for both colors */
+typedef struct
+{
+	short feature[ 2 ][ EVALUATION_FEATURES ];
+	unsigned short weight[ PATTERN_INSTANCES ];		// index of every instance's weight in its phase's pattern table
+	short label;							// result * LABEL_SCALE, from WHITE's point of view
+	char phase;
+	char validation;						// TRUE if the sample is only measured
+} FitSample;
+
+/* A slice of the samples for one fit thread */
+typedef struct
+{
+	int first, last;
+	double * input;							// weights (or a search direction) to apply
+	double * output;						// this thread's A^T ( A input - label ) or A^T A input
+	int subtractLabel;
+	double squaredError[ 2 ];				// fit and validation rows, when subtracting the labels
+	int rows[ 2 ];
+} FitJob;
+
+char * samplesFile = DEFAULT_SAMPLES_FILE;
+char * outputFile = DEFAULT_WEIGHTS_FILE;
+char * weightsFile = NULL;					// weights to start from and to play the games with (built-in if not given)
+
+int numberOfGames = 0;
+int numberOfWorkers = 0;					// 0: one per online core
+int fitThreads = 0;							// 0: one per online core
+int randomPlies = DEFAULT_RANDOM_PLIES;
+int iterations = DEFAULT_ITERATIONS;
+int hashMegabytes = DEFAULT_TRAIN_TT_MEGABYTES;
+double regularization = DEFAULT_REGULARIZATION;
+uint64_t trainSeed = 1;
+
+FILE * samplesOutput;						// the samples file while the workers play
+int gamesReceived, samplesReceived;
+
+TrainingSample * samples = NULL;
+FitSample * fitSamples = NULL;
+int totalSamples = 0;
+/**********************************************************/
+
+
+// --- Play one self-play game and label every position after the opening with its result, returns the number of samples ---
+int playGame( int game, TrainingSample gameSamples[] )
+{
+	Position pos;
+	Move move;
+	BitPosition bitPos;
+	int count = 0, seed = game;
+
+	// a game whose opening ends it gets the next seed
+	while( !gameOpening( &pos, randomPlies, trainSeed, seed ) )
+		seed += numberOfGames;
+
+	clearTranspositionTable();
+
+	while( canMove( &pos, WHITE ) || canMove( &pos, BLACK ) )
+	{
+		positionToBitPosition( &pos, &bitPos );
+		memset( &gameSamples[ count ], 0, sizeof( TrainingSample ) );
+		gameSamples[ count ].disc[ WHITE ] = bitPos.disc[ WHITE ];
+		gameSamples[ count ].disc[ BLACK ] = bitPos.disc[ BLACK ];
+		gameSamples[ count ].turn = pos.turn;
+		count++;
+
+		move.color = pos.turn;
+		if( !canMove( &pos, pos.turn ) )
+			move.tile[ 0 ] = NULL_MOVE;
+		else
+		{
+			move = getBestMove( &pos, pos.turn );
+			move.color = pos.turn;
+		}
+
+		doMove( &pos, &move );
+	}
+
+	for( int k = 0; k < count; k++ )
+		gameSamples[ k ].result = pos.score[ WHITE ] - pos.score[ BLACK ];
+
+	if( count > 0 )
+		gameSamples[ count - 1 ].endOfGame = TRUE;
+
+	return count;
+}
+
+// --- Worker process: plays games worker, worker + workers, ... and writes their samples ---
+void runWorker( int worker, int workers, int outputPipe )
+{
+	TrainingSample gameSamples[ MAX_GAME_SAMPLES ];
+
+	if( initTranspositionTable( hashMegabytes ) < 0 )
+		exit( 1 );
+
+	for( int game = worker; game < numberOfGames; game += workers )
+	{
+		ssize_t size = playGame( game, gameSamples ) * sizeof( TrainingSample );
+
+		if( write( outputPipe, gameSamples, size ) != size )
+			exit( 1 );
+	}
+}
+
+// --- Open the samples file for appending, with a header if it is new ---
+FILE * openSamplesForAppend( void )
+{
+	FILE * file;
+	char magic[ 4 ];
+	int version;
+
+	if( ( file = fopen( samplesFile, "rb" ) ) != NULL )
+	{
+		if( fread( magic, 1, 4, file ) != 4 || memcmp( magic, SAMPLE_FILE_MAGIC, 4 ) != 0
+			|| fread( &version, sizeof( int ), 1, file ) != 1 || version != SAMPLE_FILE_VERSION )
+		{
+			printf( "ERROR: %s is not a samples file of this version\n", samplesFile );
+			fclose( file );
+			return NULL;
+		}
+
+		fclose( file );
+		return fopen( samplesFile, "ab" );
+	}
+
+	version = SAMPLE_FILE_VERSION;
+	if( ( file = fopen( samplesFile, "wb" ) ) == NULL )
+		return NULL;
+
+	fwrite( SAMPLE_FILE_MAGIC, 1, 4, file );
+	fwrite( &version, sizeof( int ), 1, file );
+	return file;
+}
+
+// --- Append a sample sent by a worker, with progress every tenth of the games ---
+void appendSample( void * record )
+{
+	TrainingSample * sample = record;
+
+	fwrite( sample, sizeof( TrainingSample ), 1, samplesOutput );
+	samplesReceived++;
+
+	if( !sample->endOfGame )
+		return;
+
+	if( ++gamesReceived % max( numberOfGames / 10, 1 ) == 0 && gamesReceived < numberOfGames )
+	{
+		printf( "%d / %d games, %d samples\n", gamesReceived, numberOfGames, samplesReceived );
+		fflush( stdout );
+	}
+}
+
+// --- Play the games on one worker process per core and append their samples to the samples file ---
+int generateSamples( void )
+{
+	if( numberOfWorkers == 0 )
+		numberOfWorkers = onlineWorkers( 1 );
+	if( numberOfWorkers > numberOfGames )
+		numberOfWorkers = numberOfGames;
+
+	if( ( samplesOutput = openSamplesForAppend() ) == NULL )
+	{
+		printf( "Could not write %s\n", samplesFile );
+		return -1;
+	}
+
+	printf( "%d games, depth %d, %d workers, %d random plies, seed %llu\n", numberOfGames, searchConfig.maxDepth, numberOfWorkers, randomPlies, ( unsigned long long ) trainSeed );
+	fflush( stdout );
+
+	gamesReceived = samplesReceived = 0;
+	if( runWorkers( numberOfWorkers, runWorker, sizeof( TrainingSample ), appendSample ) < 0 )
+	{
+		fclose( samplesOutput );
+		return -1;
+	}
+
+	if( fclose( samplesOutput ) != 0 )
+	{
+		printf( "Could not write %s\n", samplesFile );
+		return -1;
+	}
+
+	printf( "%d games, %d samples added to %s\n", gamesReceived, samplesReceived, samplesFile );
+	return gamesReceived == numberOfGames ? 0 : -1;
+}
+
+// --- Read every sample of the samples file ---
+int loadSamples( void )
+{
+	FILE * file;
+	char magic[ 4 ];
+	int version;
+	long size;
+
+	if( ( file = fopen( samplesFile, "rb" ) ) == NULL )
+	{
+		printf( "ERROR: Could not open samples file %s\n", samplesFile );
+		return -1;
+	}
+
+	if( fread( magic, 1, 4, file ) != 4 || memcmp( magic, SAMPLE_FILE_MAGIC, 4 ) != 0
+		|| fread( &version, sizeof( int ), 1, file ) != 1 || version != SAMPLE_FILE_VERSION )
+	{
+		printf( "ERROR: %s is not a samples file of this version\n", samplesFile );
+		fclose( file );
+		return -1;
+	}
+
+	fseek( file, 0, SEEK_END );
+	size = ftell( file ) - 4 - sizeof( int );
+	fseek( file, 4 + sizeof( int ), SEEK_SET );
+
+	totalSamples = size / sizeof( TrainingSample );
+	if( totalSamples == 0 || ( samples = malloc( totalSamples * sizeof( TrainingSample ) ) ) == NULL
+		|| ( fitSamples = malloc( totalSamples * sizeof( FitSample ) ) ) == NULL
+		|| fread( samples, sizeof( TrainingSample ), totalSamples, file ) != ( size_t ) totalSamples )
+	{
+		printf( "ERROR: Could not read the samples of %s\n", samplesFile );
+		fclose( file );
+		return -1;
+	}
+
+	fclose( file );
+	return 0;
+}
+
+// --- Fit thread: the evaluation inputs of its slice of samples ---
+void * prepareSlice( void * argument )
+{
+	FitJob * job = argument;
+	BitPosition bitPos;
+	PatternIndices patterns;
+	int features[ EVALUATION_FEATURES ], weightIndex[ PATTERN_INSTANCES ];
+
+	for( int s = job->first; s < job->last; s++ )
+	{
+		FitSample * fit = &fitSamples[ s ];
+
+		memset( &bitPos, 0, sizeof( bitPos ) );
+		bitPos.disc[ WHITE ] = samples[ s ].disc[ WHITE ];
+		bitPos.disc[ BLACK ] = samples[ s ].disc[ BLACK ];
+		bitPos.turn = samples[ s ].turn;
+
+		for( int color = WHITE; color <= BLACK; color++ )
+		{
+			computeEvaluationFeatures( &bitPos, color, features );
+			for( int f = 0; f < EVALUATION_FEATURES; f++ )
+				fit->feature[ color ][ f ] = features[ f ];
+		}
+
+		computePatternIndices( &bitPos, &patterns );
+		patternWeightIndices( &patterns, weightIndex );
+		for( int instance = 0; instance < PATTERN_INSTANCES; instance++ )
+			fit->weight[ instance ] = weightIndex[ instance ];
+
+		fit->phase = EVALUATION_PHASE( bitScore( &bitPos, WHITE ) + bitScore( &bitPos, BLACK ) );
+		fit->label = samples[ s ].result * LABEL_SCALE;
+	}
+
+	return NULL;
+}
+
+// --- Fit thread: A^T ( A input - label ) or A^T A input over its slice, A having a row per sample and color ---
+void * multiplySlice( void * argument )
+{
+	FitJob * job = argument;
+	double * input = job->input;
+	double * output = job->output;
+
+	memset( output, 0, VARIABLES * sizeof( double ) );
+	job->squaredError[ 0 ] = job->squaredError[ 1 ] = 0.0;
+	job->rows[ 0 ] = job->rows[ 1 ] = 0;
+
+	for( int s = job->first; s < job->last; s++ )
+	{
+		FitSample * fit = &fitSamples[ s ];
+		int phase = fit->phase;
+
+		// the evaluation for BLACK reads the same pattern tables negated
+		for( int color = WHITE; color <= BLACK; color++ )
+		{
+			double sign = ( color == WHITE ) ? 1.0 : -1.0;
+			double value = 0.0, patterns = 0.0;
+			int f, instance;
+
+			for( f = 0; f < EVALUATION_FEATURES; f++ )
+				value += fit->feature[ color ][ f ] * input[ FEATURE_VARIABLE( color, phase, f ) ];
+
+			for( instance = 0; instance < PATTERN_INSTANCES; instance++ )
+				patterns += input[ PATTERN_VARIABLE( phase, fit->weight[ instance ] ) ];
+
+			value += sign * patterns;
+
+			if( job->subtractLabel )
+			{
+				value -= sign * fit->label;
+				job->squaredError[ ( int ) fit->validation ] += value * value;
+				job->rows[ ( int ) fit->validation ]++;
+			}
+
+			if( fit->validation )
+				continue;
+
+			for( f = 0; f < EVALUATION_FEATURES; f++ )
+				output[ FEATURE_VARIABLE( color, phase, f ) ] += fit->feature[ color ][ f ] * value;
+
+			for( instance = 0; instance < PATTERN_INSTANCES; instance++ )
+				output[ PATTERN_VARIABLE( phase, fit->weight[ instance ] ) ] += sign * value;
+		}
+	}
+
+	return NULL;
+}
+
+// --- Run a fit pass on every thread and add up the outputs into result (NULL if not needed) ---
+void runFitPass( void * ( * pass )( void * ), FitJob jobs[], double * input, int subtractLabel, double * result )
+{
+	pthread_t threads[ MAX_THREADS ];
+
+	for( int t = 0; t < fitThreads; t++ )
+	{
+		jobs[ t ].input = input;
+		jobs[ t ].subtractLabel = subtractLabel;
+		pthread_create( &threads[ t ], NULL, pass, &jobs[ t ] );
+	}
+
+	for( int t = 0; t < fitThreads; t++ )
+		pthread_join( threads[ t ], NULL );
+
+	if( result == NULL )
+		return;
+
+	memset( result, 0, VARIABLES * sizeof( double ) );
+	for( int t = 0; t < fitThreads; t++ )
+		for( int v = 0; v < VARIABLES; v++ )
+			result[ v ] += jobs[ t ].output[ v ];
+}
+
+// --- Root mean square error of the fit and validation rows, in discs ---
+void printError( char * label, FitJob jobs[] )
+{
+	double error[ 2 ] = { 0.0, 0.0 };
+	int rows[ 2 ] = { 0, 0 };
+
+	for( int t = 0; t < fitThreads; t++ )
+		for( int k = 0; k < 2; k++ )
+		{
+			error[ k ] += jobs[ t ].squaredError[ k ];
+			rows[ k ] += jobs[ t ].rows[ k ];
+		}
+
+	printf( "%s: fit error %.2f discs", label, sqrt( error[ 0 ] / max( rows[ 0 ], 1 ) ) / LABEL_SCALE );
+	if( rows[ 1 ] > 0 )
+		printf( ", validation error %.2f discs", sqrt( error[ 1 ] / rows[ 1 ] ) / LABEL_SCALE );
+	printf( "\n" );
+	fflush( stdout );
+}
+
+double dotProduct( double * a, double * b )
+{
+	double sum = 0.0;
+
+	for( int v = 0; v < VARIABLES; v++ )
+		sum += a[ v ] * b[ v ];
+
+	return sum;
+}
+
+// --- Least squares fit of the weights to the labels (ridge towards the starting weights, Jacobi preconditioned conjugate gradient) ---
+int fitWeights( void )
+{
+	FitJob jobs[ MAX_THREADS ];
+	double * start, * change, * residual, * preconditioned, * direction, * product, * diagonal, * current;
+	double residualDot, alpha, beta, newDot;
+	int s, t, v, game = 0, phase, color, f, samplesPerPhase[ EVALUATION_PHASES ] = { 0 };
+
+	if( fitThreads == 0 )
+	{
+		long cores = sysconf( _SC_NPROCESSORS_ONLN );
+
+		fitThreads = max( cores, 1 );
+	}
+	if( fitThreads > MAX_THREADS )
+		fitThreads = MAX_THREADS;
+	if( fitThreads > totalSamples )
+		fitThreads = totalSamples;
+
+	for( t = 0; t < fitThreads; t++ )
+	{
+		jobs[ t ].first = ( long ) totalSamples * t / fitThreads;
+		jobs[ t ].last = ( long ) totalSamples * ( t + 1 ) / fitThreads;
+		if( ( jobs[ t ].output = malloc( VARIABLES * sizeof( double ) ) ) == NULL )
+		{
+			printf( "ERROR: Out of memory\n" );
+			return -1;
+		}
+	}
+
+	runFitPass( prepareSlice, jobs, NULL, FALSE, NULL );
+
+	// whole games are kept out, the positions of one game are too alike to measure each other
+	for( s = 0; s < totalSamples; s++ )
+	{
+		fitSamples[ s ].validation = ( game % VALIDATION_GAMES == VALIDATION_GAMES - 1 );
+		if( samples[ s ].endOfGame )
+			game++;
+
+		samplesPerPhase[ ( int ) fitSamples[ s ].phase ]++;
+	}
+
+	printf( "%d samples of %d games, per phase:", totalSamples, game );
+	for( phase = 0; phase < EVALUATION_PHASES; phase++ )
+		printf( " %d", samplesPerPhase[ phase ] );
+	printf( ", %d threads\n", fitThreads );
+
+	start = malloc( VARIABLES * sizeof( double ) );
+	change = calloc( VARIABLES, sizeof( double ) );
+	residual = malloc( VARIABLES * sizeof( double ) );
+	preconditioned = malloc( VARIABLES * sizeof( double ) );
+	direction = malloc( VARIABLES * sizeof( double ) );
+	product = malloc( VARIABLES * sizeof( double ) );
+	diagonal = calloc( VARIABLES, sizeof( double ) );
+	current = malloc( VARIABLES * sizeof( double ) );
+	if( !start || !change || !residual || !preconditioned || !direction || !product || !diagonal || !current )
+	{
+		printf( "ERROR: Out of memory\n" );
+		return -1;
+	}
+
+	for( phase = 0; phase < EVALUATION_PHASES; phase++ )
+	{
+		for( color = WHITE; color <= BLACK; color++ )
+			for( f = 0; f < EVALUATION_FEATURES; f++ )
+				start[ FEATURE_VARIABLE( color, phase, f ) ] = evaluationWeights->feature[ color ][ phase ][ f ];
+
+		for( v = 0; v < PATTERN_WEIGHTS; v++ )
+			start[ PATTERN_VARIABLE( phase, v ) ] = evaluationWeights->pattern[ phase ][ v ];
+	}
+
+	// the diagonal of A^T A, plus the ridge
+	for( s = 0; s < totalSamples; s++ )
+	{
+		if( fitSamples[ s ].validation )
+			continue;
+
+		for( color = WHITE; color <= BLACK; color++ )
+		{
+			for( f = 0; f < EVALUATION_FEATURES; f++ )
+				diagonal[ FEATURE_VARIABLE( color, fitSamples[ s ].phase, f ) ] += fitSamples[ s ].feature[ color ][ f ] * fitSamples[ s ].feature[ color ][ f ];
+
+			for( int instance = 0; instance < PATTERN_INSTANCES; instance++ )
+				diagonal[ PATTERN_VARIABLE( fitSamples[ s ].phase, fitSamples[ s ].weight[ instance ] ) ] += 1.0;
+		}
+	}
+
+	for( v = 0; v < VARIABLES; v++ )
+		diagonal[ v ] += regularization;
+
+	// solve ( A^T A + ridge ) change = A^T ( label - A start )
+	runFitPass( multiplySlice, jobs, start, TRUE, residual );
+	printError( "Starting weights", jobs );
+
+	for( v = 0; v < VARIABLES; v++ )
+	{
+		residual[ v ] = -residual[ v ];
+		preconditioned[ v ] = residual[ v ] / diagonal[ v ];
+		direction[ v ] = preconditioned[ v ];
+	}
+	residualDot = dotProduct( residual, preconditioned );
+
+	for( int iteration = 1; iteration <= iterations && residualDot > 0.0; iteration++ )
+	{
+		runFitPass( multiplySlice, jobs, direction, FALSE, product );
+		for( v = 0; v < VARIABLES; v++ )
+			product[ v ] += regularization * direction[ v ];
+
+		alpha = residualDot / dotProduct( direction, product );
+
+		for( v = 0; v < VARIABLES; v++ )
+		{
+			change[ v ] += alpha * direction[ v ];
+			residual[ v ] -= alpha * product[ v ];
+			preconditioned[ v ] = residual[ v ] / diagonal[ v ];
+		}
+
+		newDot = dotProduct( residual, preconditioned );
+		beta = newDot / residualDot;
+		residualDot = newDot;
+
+		for( v = 0; v < VARIABLES; v++ )
+			direction[ v ] = preconditioned[ v ] + beta * direction[ v ];
+
+		// progress every tenth of the fit
+		if( iteration % max( iterations / 10, 1 ) == 0 || iteration == iterations )
+		{
+			char label[ 32 ];
+
+			for( v = 0; v < VARIABLES; v++ )
+				current[ v ] = start[ v ] + change[ v ];
+
+			runFitPass( multiplySlice, jobs, current, TRUE, NULL );
+			snprintf( label, sizeof( label ), "Iteration %d", iteration );
+			printError( label, jobs );
+		}
+	}
+
+	// round into the weights the evaluation uses
+	for( v = 0; v < VARIABLES; v++ )
+	{
+		current[ v ] = round( start[ v ] + change[ v ] );
+		current[ v ] = current[ v ] > INT16_MAX ? INT16_MAX : current[ v ] < -INT16_MAX ? -INT16_MAX : current[ v ];
+	}
+
+	for( phase = 0; phase < EVALUATION_PHASES; phase++ )
+	{
+		for( color = WHITE; color <= BLACK; color++ )
+			for( f = 0; f < EVALUATION_FEATURES; f++ )
+				evaluationWeights->feature[ color ][ phase ][ f ] = current[ FEATURE_VARIABLE( color, phase, f ) ];
+
+		for( v = 0; v < PATTERN_WEIGHTS; v++ )
+			evaluationWeights->pattern[ phase ][ v ] = current[ PATTERN_VARIABLE( phase, v ) ];
+
+		printf( "Phase %d features (white | black):", phase );
+		for( color = WHITE; color <= BLACK; color++ )
+			for( f = 0; f < EVALUATION_FEATURES; f++ )
+				printf( " %d", evaluationWeights->feature[ color ][ phase ][ f ] );
+		printf( "\n" );
+	}
+
+	return 0;
+}
+
+/**********************************************************/
+
+// --- Main ---
+int main( int argc, char ** argv )
+{
+	int c;
+	opterr = 0;
+
+	// a fixed depth and no clock, the games only depend on the options
+	searchConfig.moveTime = 0;
+	searchConfig.maxDepth = DEFAULT_TRAIN_DEPTH;
+
+	while( ( c = getopt ( argc, argv, "g:f:o:w:d:r:s:j:t:i:l:m:h" ) ) != -1 )
+		switch( c )
+		{
+			case 'h':
+				printf( "[-g games_to_play] [-f samples_file] [-o weights_file] [-w starting_weights_file] [-d depth] [-r random_opening_plies] [-s seed] [-j workers] [-t fit_threads] [-i iterations] [-l ridge] [-m hash_table_MB]\n" );
+				return 0;
+			case 'g':
+				numberOfGames = atoi( optarg );
+				break;
+			case 'f':
+				samplesFile = optarg;
+				break;
+			case 'o':
+				outputFile = optarg;
+				break;
+			case 'w':
+				weightsFile = optarg;
+				break;
+			case 'd':
+				searchConfig.maxDepth = atoi( optarg );
+				if( searchConfig.maxDepth < 1 || searchConfig.maxDepth > MAX_SEARCH_DEPTH )
+				{
+					printf( "Depth must be between 1 and %d\n", MAX_SEARCH_DEPTH );
+					return 1;
+				}
+				break;
+			case 'r':
+				randomPlies = atoi( optarg );
+				break;
+			case 's':
+				trainSeed = strtoull( optarg, NULL, 10 );
+				break;
+			case 'j':
+				numberOfWorkers = atoi( optarg );
+				if( numberOfWorkers < 1 || numberOfWorkers > MAX_WORKERS )
+				{
+					printf( "Workers must be between 1 and %d\n", MAX_WORKERS );
+					return 1;
+				}
+				break;
+			case 't':
+				fitThreads = atoi( optarg );
+				if( fitThreads < 1 || fitThreads > MAX_THREADS )
+				{
+					printf( "Threads must be between 1 and %d\n", MAX_THREADS );
+					return 1;
+				}
+				break;
+			case 'i':
+				iterations = atoi( optarg );
+				break;
+			case 'l':
+				regularization = atof( optarg );
+				if( regularization <= 0.0 )
+				{
+					printf( "The ridge must be positive\n" );
+					return 1;
+				}
+				break;
+			case 'm':
+				hashMegabytes = atoi( optarg );
+				break;
+			case '?':
+				if( optopt == 'g' || optopt == 'f' || optopt == 'o' || optopt == 'w' || optopt == 'd' || optopt == 'r' || optopt == 's' || optopt == 'j' || optopt == 't' || optopt == 'i' || optopt == 'l' || optopt == 'm' )
+					printf( "Option -%c requires an argument.\n", ( char ) optopt );
+				else if( isprint( optopt ) )
+					printf( "Unknown option -%c\n", ( char ) optopt );
+				else
+					printf( "Unknown option character -%c\n", ( char ) optopt );
+				return 1;
+			default:
+			return 1;
+		}
+
+	initBoardTables();
+	initPatterns();
+	initSearch();
+
+	if( weightsFile != NULL && loadEvaluationWeights( weightsFile ) < 0 )
+		return 1;
+
+	if( numberOfGames > 0 && generateSamples() < 0 )
+		return 1;
+
+	// -i 0 only plays games
+	if( iterations <= 0 )
+		return 0;
+
+	if( loadSamples() < 0 || fitWeights() < 0 )
+		return 1;
+
+	if( saveEvaluationWeights( outputFile ) < 0 )
+		return 1;
+
+	printf( "Weights written to %s\n", outputFile );
+	return 0;
+}
@@ -0,0 +1,110 @@
+#include "transposition.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**********************************************************/
+/* buckets of two entries: the first keeps the deepest result, the second always takes the newest */
+#define BUCKET_SIZE 2
+
+static TranspositionTable defaultTable = { NULL, 0 };
+
+/* the selected table, copied out of its struct so that probes don't go through another pointer */
+static TTEntry * table = NULL;
+static uint64_t tableMask;				//number of buckets - 1
+
+/**********************************************************/
+static uint64_t packData( int depth, int bound, int score, int move )
+{
+	return ( uint64_t ) ( uint32_t ) score | ( ( uint64_t ) ( depth & 0xFF ) << 32 ) | ( ( uint64_t ) ( bound & 0x3 ) << 40 ) | ( ( uint64_t ) ( move & 0xFF ) << 48 );
+}
+
+/**********************************************************/
+static void unpackData( uint64_t data, TTData * entry )
+{
+	entry->score = ( int ) ( int32_t ) ( uint32_t ) data;
+	entry->depth = ( data >> 32 ) & 0xFF;
+	entry->bound = ( data >> 40 ) & 0x3;
+	entry->move = ( data >> 48 ) & 0xFF;
+}
+
+/**********************************************************/
+int initTranspositionTable( int megabytes )
+{
+	if( allocTranspositionTable( &defaultTable, megabytes ) < 0 )
+		return -1;
+
+	selectTranspositionTable( &defaultTable );
+	return 0;
+}
+
+/**********************************************************/
+int allocTranspositionTable( TranspositionTable * tt, int megabytes )
+{
+	uint64_t buckets = 1;
+
+	while( buckets * 2 * BUCKET_SIZE * sizeof( TTEntry ) <= ( uint64_t ) megabytes * 1024 * 1024 )
+		buckets *= 2;
+
+	free( tt->entries );
+
+	if( ( tt->entries = calloc( buckets * BUCKET_SIZE, sizeof( TTEntry ) ) ) == NULL )
+	{
+		printf( "ERROR: Could not allocate %d MB for the transposition table\n", megabytes );
+		return -1;
+	}
+
+	tt->mask = buckets - 1;
+
+	return 0;
+}
+
+/**********************************************************/
+void selectTranspositionTable( TranspositionTable * tt )
+{
+	table = tt->entries;
+	tableMask = tt->mask;
+}
+
+/**********************************************************/
+void clearTranspositionTable( void )
+{
+	memset( table, 0, ( tableMask + 1 ) * BUCKET_SIZE * sizeof( TTEntry ) );
+}
+
+/**********************************************************/
+int probeTransposition( uint64_t hash, TTData * entry )
+{
+	TTEntry * bucket = &table[ ( hash & tableMask ) * BUCKET_SIZE ];
+	int i;
+
+	for( i = 0; i < BUCKET_SIZE; i++ )
+	{
+		uint64_t data = bucket[ i ].data;
+
+		if( ( bucket[ i ].key ^ data ) == hash && data != 0 )
+		{
+			unpackData( data, entry );
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/**********************************************************/
+void storeTransposition( uint64_t hash, int depth, int bound, int score, int move )
+{
+	TTEntry * bucket = &table[ ( hash & tableMask ) * BUCKET_SIZE ];
+	uint64_t data = packData( depth, bound, score, move );
+	TTEntry * slot;
+
+	/* same position or a deeper result goes to the depth-preferred slot, anything else to the other one */
+	if( ( bucket[ 0 ].key ^ bucket[ 0 ].data ) == hash || depth >= ( int ) ( ( bucket[ 0 ].data >> 32 ) & 0xFF ) )
+		slot = &bucket[ 0 ];
+	else
+		slot = &bucket[ 1 ];
+
+	slot->key = hash ^ data;
+	slot->data = data;
+}
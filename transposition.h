@@ -0,0 +1,60 @@
+#ifndef _TRANSPOSITION_H
+#define _TRANSPOSITION_H
+
+#include "global.h"
+#include <stdint.h>
+
+/**********************************************************/
+/* bound types of a stored score */
+#define TT_EXACT 0
+#define TT_LOWER 1			//real value >= score (search failed high)
+#define TT_UPPER 2			//real value <= score (search failed low)
+
+#define TT_NO_MOVE 255		//stored instead of a bit index when there is no best move
+
+#define DEFAULT_TT_MEGABYTES 64
+
+/**********************************************************/
+/* Entry as seen by the search */
+typedef struct
+{
+	int score;
+	int depth;
+	int bound;
+	int move;				//bit index of the best move or TT_NO_MOVE
+} TTData;
+
+/* Entry as stored: the key is xor-ed with the data so that an entry torn by a concurrent write never matches */
+typedef struct
+{
+	uint64_t key;
+	uint64_t data;
+} TTEntry;
+
+/* A table of its own, for programs that keep several engines in one process */
+typedef struct
+{
+	TTEntry * entries;
+	uint64_t mask;			//number of buckets - 1
+} TranspositionTable;
+
+/**********************************************************/
+int initTranspositionTable( int megabytes );
+//allocates the table (rounded down to a power of two entries), returns -1 on failure
+
+int allocTranspositionTable( TranspositionTable * tt, int megabytes );
+//same for a separate table (entries must be NULL or a previous allocation), it is not used until selected
+
+void selectTranspositionTable( TranspositionTable * tt );
+//makes probe/store/clear work on tt until the next select
+
+void clearTranspositionTable( void );
+//forgets every entry (scores depend on the root color, so call it whenever that changes)
+
+int probeTransposition( uint64_t hash, TTData * entry );
+//fills entry and returns TRUE if the position is in the table
+
+void storeTransposition( uint64_t hash, int depth, int bound, int score, int move );
+//stores a search result (deeper results are kept over shallower ones in the same bucket)
+
+#endif